@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include <vector>
+#include <algorithm>
+
+#include "ftdi_axi_driver.h"
+#include "ftdi_ft60x.h"
+#include "ftdi_emu.h"
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+#define BENCH_MAX_LIST      16
+#define BENCH_MAX_OP_SIZE   (64 * 1024 * 1024)
+
+enum
+{
+    WORKLOAD_READ,
+    WORKLOAD_WRITE,
+    WORKLOAD_WRITE_POSTED,
+    WORKLOAD_MIXED,
+    WORKLOAD_COUNT
+};
+
+static const char *workload_names[WORKLOAD_COUNT] = { "read", "write", "write_posted", "mixed" };
+
+//-----------------------------------------------------------------
+// tBenchResult: One point of the sweep
+//-----------------------------------------------------------------
+typedef struct BenchResult
+{
+    int      workload;
+    int      size;
+    int      align;
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t errors;
+    double   seconds;
+    double   lat_p50;   // us
+    double   lat_p99;
+    double   lat_p999;
+    double   lat_max;
+} tBenchResult;
+
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "d:a:s:u:w:t:c:q:j:l:Eb:L:h"
+
+static struct option long_options[] =
+{
+    {"device",     required_argument, 0, 'd'},
+    {"addr",       required_argument, 0, 'a'},
+    {"sizes",      required_argument, 0, 's'},
+    {"align",      required_argument, 0, 'u'},
+    {"workloads",  required_argument, 0, 'w'},
+    {"time",       required_argument, 0, 't'},
+    {"config",     required_argument, 0, 'c'},
+    {"queue",      required_argument, 0, 'q'},
+    {"json",       required_argument, 0, 'j'},
+    {"label",      required_argument, 0, 'l'},
+    {"emulate",    no_argument,       0, 'E'},
+    {"bandwidth",  required_argument, 0, 'b'},
+    {"latency",    required_argument, 0, 'L'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --device     | -d IDX        Device index to use (default: 0)\n");
+    fprintf (stderr,"  --addr       | -a ADDR       Scratch memory address (contents are overwritten)\n");
+    fprintf (stderr,"  --sizes      | -s LIST       Transfer sizes (default: 4,64,1024,65536,1048576)\n");
+    fprintf (stderr,"  --align      | -u LIST       Address offsets (default: 0)\n");
+    fprintf (stderr,"  --workloads  | -w LIST       read,write,write_posted,mixed (default: all)\n");
+    fprintf (stderr,"  --time       | -t SECS       Duration per point (default: 2)\n");
+    fprintf (stderr,"  --config     | -c FILENAME   Driver settings file (see tune)\n");
+    fprintf (stderr,"  --queue      | -q DEPTH      Overlapped USB transfers per direction (default: 0)\n");
+    fprintf (stderr,"  --json       | -j FILENAME   Write results as JSON ('-' for stdout)\n");
+    fprintf (stderr,"  --label      | -l TEXT       Free text recorded in the JSON (host, kernel, ...)\n");
+    fprintf (stderr,"  --emulate    | -E            Use the in-process target emulator\n");
+    fprintf (stderr,"  --bandwidth  | -b MB/s       Emulator link bandwidth (default: unlimited)\n");
+    fprintf (stderr,"  --latency    | -L US         Emulator per-transfer latency (default: 0)\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// parse_list: Comma separated integers
+//-----------------------------------------------------------------
+static int parse_list(const char *str, int *list, int max)
+{
+    int count = 0;
+
+    while (*str && count < max)
+    {
+        char *end;
+        list[count++] = strtol(str, &end, 0);
+        if (end == str)
+            return -1;
+        str = (*end == ',') ? end + 1 : end;
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------
+// parse_workloads: Comma separated workload names
+//-----------------------------------------------------------------
+static int parse_workloads(const char *str, int *list, int max)
+{
+    int count = 0;
+
+    while (*str && count < max)
+    {
+        int len = strcspn(str, ",");
+        int w;
+        for (w=0;w<WORKLOAD_COUNT;w++)
+            if ((int)strlen(workload_names[w]) == len && !strncmp(str, workload_names[w], len))
+                break;
+        if (w == WORKLOAD_COUNT)
+            return -1;
+
+        list[count++] = w;
+        str += len;
+        if (*str == ',')
+            str++;
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------
+// time_now: Monotonic time in seconds
+//-----------------------------------------------------------------
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+//-----------------------------------------------------------------
+// percentile: Nearest rank on a sorted sample set
+//-----------------------------------------------------------------
+static double percentile(const std::vector<float> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t idx = (size_t)(p * sorted.size());
+    if (idx >= sorted.size())
+        idx = sorted.size() - 1;
+    return sorted[idx];
+}
+//-----------------------------------------------------------------
+// bench_op: One timed operation. Single aligned words use the
+// register commands, everything else the block path.
+//-----------------------------------------------------------------
+static bool bench_op(ftdi_axi_driver &driver, int workload, uint32_t addr, uint8_t *buf, int size, uint64_t n)
+{
+    bool word = (size == 4) && !(addr & 3);
+
+    if (workload == WORKLOAD_MIXED)
+        workload = (n & 1) ? WORKLOAD_READ : WORKLOAD_WRITE;
+
+    switch (workload)
+    {
+        case WORKLOAD_READ:
+            if (word)
+            {
+                uint32_t value;
+                return driver.read32(addr, value);
+            }
+            return driver.read(addr, buf, size);
+        case WORKLOAD_WRITE:
+            if (word)
+                return driver.write32(addr, n, 100, false);
+            return driver.write(addr, buf, size, 100, false);
+        case WORKLOAD_WRITE_POSTED:
+            if (word)
+                return driver.write32(addr, n, 100, true);
+            return driver.write(addr, buf, size, 100, true);
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------
+// bench_run: Repeat one workload for a fixed duration
+//-----------------------------------------------------------------
+static void bench_run(ftdi_axi_driver &driver, tBenchResult &res, uint32_t addr, uint8_t *buf, double duration, std::vector<float> &lat)
+{
+    lat.clear();
+    res.ops    = 0;
+    res.bytes  = 0;
+    res.errors = 0;
+
+    double t_start = time_now();
+    double t_end   = t_start + duration;
+    double t1      = t_start;
+
+    while (t1 < t_end)
+    {
+        bool ok  = bench_op(driver, res.workload, addr + res.align, buf, res.size, res.ops);
+        double t2 = time_now();
+
+        lat.push_back((float)((t2 - t1) * 1000000.0));
+        res.ops++;
+        if (ok)
+            res.bytes += res.size;
+        else
+        {
+            res.errors++;
+
+            // Resynchronise the target before carrying on
+            driver.send_drain(1000);
+            t2 = time_now();
+        }
+        t1 = t2;
+    }
+
+    res.seconds = t1 - t_start;
+
+    std::sort(lat.begin(), lat.end());
+    res.lat_p50  = percentile(lat, 0.50);
+    res.lat_p99  = percentile(lat, 0.99);
+    res.lat_p999 = percentile(lat, 0.999);
+    res.lat_max  = lat.empty() ? 0 : lat.back();
+}
+//-----------------------------------------------------------------
+// write_json: Dump results with enough context to compare runs
+//-----------------------------------------------------------------
+static void write_json(FILE *f, const char *label, bool emulate, ftdi_axi_driver &driver, int queue, std::vector<tBenchResult> &results)
+{
+    struct utsname uts;
+    memset(&uts, 0, sizeof(uts));
+    uname(&uts);
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"tool\": \"bench\",\n");
+    fprintf(f, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(f, "  \"label\": \"");
+    for (const char *p = label ? label : ""; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', f);
+        if ((unsigned char)*p >= 0x20)
+            fputc(*p, f);
+    }
+    fprintf(f, "\",\n");
+    fprintf(f, "  \"host\": { \"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\" },\n",
+            uts.sysname, uts.release, uts.machine);
+    fprintf(f, "  \"transport\": \"%s\",\n", emulate ? "emulator" : "ft60x");
+    fprintf(f, "  \"settings\": { \"chunk_size\": %d, \"batch_chunks\": %d, \"fence_interval\": %d, \"queue\": %d },\n",
+            driver.get_chunk_size(), driver.get_batch_chunks(), driver.get_fence_interval(), queue);
+    fprintf(f, "  \"results\": [\n");
+    for (size_t i=0;i<results.size();i++)
+    {
+        tBenchResult &r = results[i];
+        double secs = r.seconds > 0 ? r.seconds : 1;
+
+        fprintf(f, "    { \"workload\": \"%s\", \"size\": %d, \"align\": %d, \"ops\": %llu, \"errors\": %llu, "
+                   "\"seconds\": %.3f, \"mb_s\": %.3f, \"ops_s\": %.1f, "
+                   "\"lat_us\": { \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f } }%s\n",
+                workload_names[r.workload], r.size, r.align,
+                (unsigned long long)r.ops, (unsigned long long)r.errors,
+                r.seconds, (r.bytes / (1024.0 * 1024.0)) / secs, r.ops / secs,
+                r.lat_p50, r.lat_p99, r.lat_p999, r.lat_max,
+                (i + 1) < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help        = 0;
+    int device      = 0;
+    uint32_t addr   = 0xFFFFFFFF;
+    double duration = 2.0;
+    char *config    = NULL;
+    char *json      = NULL;
+    char *label     = NULL;
+    int queue       = 0;
+    bool emulate    = false;
+    int bandwidth   = 0;
+    int latency     = 0;
+
+    int sizes[BENCH_MAX_LIST]     = { 4, 64, 1024, 65536, 1048576 };
+    int num_sizes                 = 5;
+    int aligns[BENCH_MAX_LIST]    = { 0 };
+    int num_aligns                = 1;
+    int workloads[BENCH_MAX_LIST] = { WORKLOAD_READ, WORKLOAD_WRITE, WORKLOAD_WRITE_POSTED, WORKLOAD_MIXED };
+    int num_workloads             = WORKLOAD_COUNT;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 'd':
+                 device = strtoul(optarg, NULL, 0);
+                 break;
+            case 'a':
+                 addr = strtoul(optarg, NULL, 0) & ~3;
+                 break;
+            case 's':
+                 num_sizes = parse_list(optarg, sizes, BENCH_MAX_LIST);
+                 break;
+            case 'u':
+                 num_aligns = parse_list(optarg, aligns, BENCH_MAX_LIST);
+                 break;
+            case 'w':
+                 num_workloads = parse_workloads(optarg, workloads, BENCH_MAX_LIST);
+                 break;
+            case 't':
+                 duration = strtod(optarg, NULL);
+                 break;
+            case 'c':
+                 config = optarg;
+                 break;
+            case 'q':
+                 queue = strtoul(optarg, NULL, 0);
+                 break;
+            case 'j':
+                 json = optarg;
+                 break;
+            case 'l':
+                 label = optarg;
+                 break;
+            case 'E':
+                 emulate = true;
+                 break;
+            case 'b':
+                 bandwidth = strtoul(optarg, NULL, 0);
+                 break;
+            case 'L':
+                 latency = strtoul(optarg, NULL, 0);
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (emulate && addr == 0xFFFFFFFF)
+        addr = 0;
+
+    if (help || addr == 0xFFFFFFFF || duration <= 0 || num_sizes <= 0 || num_aligns <= 0 || num_workloads <= 0)
+    {
+        help_options();
+        return -1;
+    }
+
+    int max_size = 0;
+    for (int i=0;i<num_sizes;i++)
+    {
+        if (sizes[i] <= 0 || sizes[i] > BENCH_MAX_OP_SIZE)
+        {
+            fprintf (stderr,"Error: Bad transfer size %d\n", sizes[i]);
+            return -1;
+        }
+        max_size = std::max(max_size, sizes[i]);
+    }
+
+    // Open the port
+    ftdi_ft60x port_hw;
+    ftdi_emu   port_emu;
+    ftdi_driver_api *port = &port_hw;
+    if (emulate)
+    {
+        port_emu.set_bandwidth(bandwidth);
+        port_emu.set_latency(latency);
+        port = &port_emu;
+    }
+    else
+        port_hw.set_overlapped(queue);
+
+    if (!port->open(device))
+        return -1;
+
+    // Reset target state machines
+    ftdi_axi_driver driver(port);
+    if (config && !driver.load_settings(config))
+    {
+        fprintf (stderr,"Error: Could not load settings from %s\n", config);
+        port->close();
+        return -1;
+    }
+    driver.send_drain(1000);
+    port->sleep(10000);
+
+    uint8_t *buf = new uint8_t[max_size];
+    for (int i=0;i<max_size;i++)
+        buf[i] = rand();
+
+    // Human readable output goes to stderr when the JSON is on stdout
+    FILE *log = (json && !strcmp(json, "-")) ? stderr : stdout;
+    fprintf(log, "%-13s %9s %5s %10s %11s %9s %9s %9s %9s %6s\n",
+            "workload", "size", "align", "MB/s", "ops/s", "p50(us)", "p99(us)", "p999(us)", "max(us)", "errors");
+
+    std::vector<tBenchResult> results;
+    std::vector<float>        lat;
+    lat.reserve(1 << 20);
+
+    for (int w=0;w<num_workloads;w++)
+        for (int s=0;s<num_sizes;s++)
+            for (int a=0;a<num_aligns;a++)
+            {
+                tBenchResult res;
+                memset(&res, 0, sizeof(res));
+                res.workload = workloads[w];
+                res.size     = sizes[s];
+                res.align    = aligns[a];
+
+                bench_run(driver, res, addr, buf, duration, lat);
+                results.push_back(res);
+
+                double secs = res.seconds > 0 ? res.seconds : 1;
+                fprintf(log, "%-13s %9d %5d %10.2f %11.1f %9.1f %9.1f %9.1f %9.1f %6llu\n",
+                        workload_names[res.workload], res.size, res.align,
+                        (res.bytes / (1024.0 * 1024.0)) / secs, res.ops / secs,
+                        res.lat_p50, res.lat_p99, res.lat_p999, res.lat_max,
+                        (unsigned long long)res.errors);
+            }
+
+    bool ok = true;
+    if (json)
+    {
+        FILE *f = strcmp(json, "-") ? fopen(json, "w") : stdout;
+        if (f)
+        {
+            write_json(f, label, emulate, driver, queue, results);
+            if (f != stdout)
+                fclose(f);
+        }
+        else
+        {
+            fprintf (stderr,"Error: Could not open %s\n", json);
+            ok = false;
+        }
+    }
+
+    delete[] buf;
+    if (!driver.flush())
+        ok = false;
+    port->close();
+    return ok ? 0 : -1;
+}
@@ -8,6 +8,9 @@
 
 #include "ftdi_axi_driver.h"
 #include "ftdi_ft60x.h"
+#ifdef FTDI_VSIM
+#include "ftdi_vsim.h"
+#endif
 
 #define MEASURE_START(_t) gettimeofday(&_t, NULL)
 
@@ -17,10 +20,17 @@
                 _elapsed += (t2.tv_usec - t1.tv_usec) / 1000.0; \
             } while (0)
 
+// Co-simulation: report target clocks for the last interval
+#ifdef FTDI_VSIM
+#define VSIM_REPORT(_port) do { (_port).print_stats(stdout); (_port).reset_stats(); } while (0)
+#else
+#define VSIM_REPORT(_port)
+#endif
+
 //-----------------------------------------------------------------
 // Command line options
 //-----------------------------------------------------------------
-#define GETOPTS_ARGS "d:t:a:s:h"
+#define GETOPTS_ARGS "d:t:a:s:c:q:h"
 
 static struct option long_options[] =
 {
@@ -28,6 +38,8 @@ static struct option long_options[] =
     {"test",       required_argument, 0, 't'},
     {"addr",       required_argument, 0, 'a'},
     {"size",       required_argument, 0, 's'},
+    {"config",     required_argument, 0, 'c'},
+    {"queue",      required_argument, 0, 'q'},
     {"help",       no_argument,       0, 'h'},
     {0, 0, 0, 0}
 };
@@ -39,6 +51,8 @@ static void help_options(void)
     fprintf (stderr,"  --test       | -t IDX        Test index (default: 0)\n");
     fprintf (stderr,"  --addr       | -a ADDR       Test arg address\n");
     fprintf (stderr,"  --size       | -s SIZE       Test arg size\n");
+    fprintf (stderr,"  --config     | -c FILENAME   Driver settings file (see tune)\n");
+    fprintf (stderr,"  --queue      | -q DEPTH      Overlapped USB transfers per direction (default: 0)\n");
     exit(-1);
 }
 //-----------------------------------------------------------------
@@ -52,6 +66,8 @@ int main(int argc, char *argv[])
     int test_idx  = 0;
     uint32_t addr = 0;
     uint32_t size = (64 * 1024);
+    char *config  = NULL;
+    int queue     = 0;
 
     int option_index = 0;
     while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
@@ -70,6 +86,12 @@ int main(int argc, char *argv[])
             case 's':
                  size = strtol(optarg, NULL, 0);
                  break;
+            case 'c':
+                 config = optarg;
+                 break;
+            case 'q':
+                 queue = strtoul(optarg, NULL, 0);
+                 break;
             default:
                 help = 1;
                 break;
@@ -83,12 +105,23 @@ int main(int argc, char *argv[])
     }
 
     // Open the port
+#ifdef FTDI_VSIM
+    ftdi_vsim port;
+#else
     ftdi_ft60x port;
+    port.set_overlapped(queue);
+#endif
     if (!port.open(0))
         return -1;
 
     // Reset target state machines
     ftdi_axi_driver driver(&port);
+    if (config && !driver.load_settings(config))
+    {
+        fprintf (stderr,"Error: Could not load settings from %s\n", config);
+        port.close();
+        return -1;
+    }
     driver.send_drain(1000);
     port.sleep(10000);
 
@@ -127,6 +160,7 @@ int main(int argc, char *argv[])
                 if (duration >= 1000.0)
                 {
                     printf("Data rate: %dKB per s\n", total_data / 1024);
+                    VSIM_REPORT(port);
                     total_data = 0;
                     MEASURE_START(t1);
                 }
@@ -152,6 +186,7 @@ int main(int argc, char *argv[])
                 if (duration >= 1000.0)
                 {
                     printf("Data rate: %dKB per s\n", total_data / 1024);
+                    VSIM_REPORT(port);
                     total_data = 0;
                     MEASURE_START(t1);
                 }
@@ -190,7 +225,37 @@ int main(int argc, char *argv[])
                 if (duration >= 1000.0)
                 {
                     printf("Data rate: %dKB per s\n", total_data / 1024);
+                    VSIM_REPORT(port);
+                    total_data = 0;
+                    MEASURE_START(t1);
+                }
+            }
+        }
+        break;
+        case 4:
+        {
+            printf("TEST: Read performance, standard vs stream pipe - press CTRL-C to stop...\n");
+
+            uint32_t total_data = 0;
+            struct timeval t1, t2;
+            double duration;
+            bool stream = false;
+            uint8_t *read_buf = new uint8_t[size];
+            MEASURE_START(t1);
+            while (true)
+            {
+                driver.set_stream_reads(stream);
+                if (!driver.read(addr, read_buf, size))
+                    return -1;
+                total_data += size;
+
+                MEASURE_STOP(t2, t1, duration); 
+                if (duration >= 1000.0)
+                {
+                    printf("Data rate (%s): %dKB per s\n", stream ? "stream  " : "standard", total_data / 1024);
+                    VSIM_REPORT(port);
                     total_data = 0;
+                    stream = !stream;
                     MEASURE_START(t1);
                 }
             }
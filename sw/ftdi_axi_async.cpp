@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ftdi_axi_async.h"
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_protocol.h"
+
+#define ASYNC_TIMEOUT_MS  1000
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_axi_async::ftdi_axi_async(ftdi_driver_api *port, int chunk_size): m_batch(chunk_size)
+{
+    m_port    = port;
+    m_seq_num = 1;
+
+    m_write_buf = (uint8_t *)malloc(WRITE_BUF_SIZE);
+    m_read_buf  = (uint8_t *)malloc(READ_BUF_SIZE);
+
+    m_stub.next.store(NULL);
+    m_head.store(&m_stub);
+    m_tail = &m_stub;
+    m_pending.store(0);
+
+    m_running.store(false);
+    m_stat_ops.store(0);
+    m_stat_transfers.store(0);
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_axi_async::~ftdi_axi_async()
+{
+    stop();
+
+    // Fail anything submitted but never processed
+    Request *req;
+    while ((req = pop()) != NULL)
+        complete(req, false, 0);
+
+    free(m_write_buf);
+    free(m_read_buf);
+}
+//-------------------------------------------------------------
+// start: Start the I/O thread
+//-------------------------------------------------------------
+bool ftdi_axi_async::start(void)
+{
+    if (m_running.load())
+        return true;
+
+    if (!m_write_buf || !m_read_buf)
+        return false;
+
+    m_running.store(true);
+    m_thread = std::thread(&ftdi_axi_async::io_thread, this);
+    return true;
+}
+//-------------------------------------------------------------
+// stop: Complete outstanding work and stop the I/O thread
+//-------------------------------------------------------------
+void ftdi_axi_async::stop(void)
+{
+    if (!m_running.load())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_running.store(false);
+        m_wake.notify_one();
+    }
+
+    m_thread.join();
+}
+//-------------------------------------------------------------
+// push: Enqueue a request (any thread)
+//-------------------------------------------------------------
+void ftdi_axi_async::push(Request *req)
+{
+    req->next.store(NULL, std::memory_order_relaxed);
+    Request *prev = m_head.exchange(req, std::memory_order_acq_rel);
+    prev->next.store(req, std::memory_order_release);
+
+    // Wake the I/O thread on the empty -> non-empty transition
+    if (m_pending.fetch_add(1) == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_wake.notify_one();
+    }
+}
+//-------------------------------------------------------------
+// pop: Dequeue a request (I/O thread only). May return NULL while
+// a producer is part way through push().
+//-------------------------------------------------------------
+ftdi_axi_async::Request *ftdi_axi_async::pop(void)
+{
+    Request *tail = m_tail;
+    Request *next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &m_stub)
+    {
+        if (!next)
+            return NULL;
+        m_tail = next;
+        tail   = next;
+        next   = next->next.load(std::memory_order_acquire);
+    }
+
+    if (!next)
+    {
+        if (tail != m_head.load(std::memory_order_acquire))
+            return NULL;
+
+        // Re-insert the stub so the last request can be detached
+        m_stub.next.store(NULL, std::memory_order_relaxed);
+        Request *prev = m_head.exchange(&m_stub, std::memory_order_acq_rel);
+        prev->next.store(&m_stub, std::memory_order_release);
+
+        next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return NULL;
+    }
+
+    m_tail = next;
+    m_pending.fetch_sub(1);
+    return tail;
+}
+//-------------------------------------------------------------
+// complete: Finish a request and release it
+//-------------------------------------------------------------
+void ftdi_axi_async::complete(Request *req, bool ok, uint32_t value)
+{
+    if (ok && req->result)
+        *req->result = value;
+
+    if (req->promise)
+    {
+        req->promise->set_value(ok);
+        delete req->promise;
+    }
+
+    if (req->cb)
+        req->cb(req->ctx, ok, value);
+
+    delete req;
+}
+//-------------------------------------------------------------
+// submit: Queue an operation with a completion callback
+//-------------------------------------------------------------
+bool ftdi_axi_async::submit(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value, tCallback cb, void *ctx)
+{
+    Request *req = new Request;
+    req->cmd_id  = cmd_id;
+    req->addr    = addr;
+    req->data    = data;
+    req->length  = length;
+    req->value   = value;
+    req->result  = NULL;
+    req->promise = NULL;
+    req->cb      = cb;
+    req->ctx     = ctx;
+    push(req);
+    return true;
+}
+//-------------------------------------------------------------
+// submit_future: Queue an operation completed via a future
+//-------------------------------------------------------------
+std::future<bool> ftdi_axi_async::submit_future(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value, uint32_t *result)
+{
+    Request *req = new Request;
+    req->cmd_id  = cmd_id;
+    req->addr    = addr;
+    req->data    = data;
+    req->length  = length;
+    req->value   = value;
+    req->result  = result;
+    req->promise = new std::promise<bool>();
+    req->cb      = NULL;
+    req->ctx     = NULL;
+
+    std::future<bool> f = req->promise->get_future();
+    push(req);
+    return f;
+}
+//-------------------------------------------------------------
+// Operations
+//-------------------------------------------------------------
+std::future<bool> ftdi_axi_async::read32(uint32_t addr, uint32_t *data)
+{
+    return submit_future(CMD_ID_READ, addr, NULL, 4, 0, data);
+}
+std::future<bool> ftdi_axi_async::write32(uint32_t addr, uint32_t data, bool posted)
+{
+    return submit_future(posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, NULL, 4, data, NULL);
+}
+std::future<bool> ftdi_axi_async::read(uint32_t addr, uint8_t *data, int length)
+{
+    return submit_future(CMD_ID_READ, addr, data, length, 0, NULL);
+}
+std::future<bool> ftdi_axi_async::write(uint32_t addr, uint8_t *data, int length, bool posted)
+{
+    return submit_future(posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, data, length, 0, NULL);
+}
+std::future<bool> ftdi_axi_async::gpio_write(uint32_t value)
+{
+    return submit_future(CMD_ID_GPIO_WR, 0, NULL, 4, value, NULL);
+}
+std::future<bool> ftdi_axi_async::gpio_read(uint32_t *value)
+{
+    return submit_future(CMD_ID_GPIO_RD, 0, NULL, 4, 0, value);
+}
+//-------------------------------------------------------------
+// process: Batch everything pending into one USB transfer
+//-------------------------------------------------------------
+bool ftdi_axi_async::process(Request *&carry)
+{
+    m_batch.clear();
+
+    // Request which did not fit in the previous batch goes first
+    if (carry)
+    {
+        if (m_batch.add(carry->cmd_id, carry->addr, carry->data, carry->length, carry->value, carry) < 0)
+            complete(carry, false, 0);
+        carry = NULL;
+    }
+
+    Request *req;
+    while ((req = pop()) != NULL)
+    {
+        if (m_batch.add(req->cmd_id, req->addr, req->data, req->length, req->value, req) < 0)
+        {
+            // Invalid on its own, or the batch is full
+            if (m_batch.count() == 0)
+                complete(req, false, 0);
+            else
+            {
+                carry = req;
+                break;
+            }
+        }
+    }
+
+    if (m_batch.count() == 0)
+    {
+        std::this_thread::yield();
+        return true;
+    }
+
+    bool ok = m_batch.transact(m_port, m_write_buf, m_read_buf, m_seq_num, ASYNC_TIMEOUT_MS);
+
+    for (int i=0;i<m_batch.count();i++)
+    {
+        tAxiOp &op = m_batch.op(i);
+        complete((Request *)op.ctx, ok && op.ok, op.value);
+    }
+
+    m_stat_ops += m_batch.count();
+    m_stat_transfers++;
+    return ok;
+}
+//-------------------------------------------------------------
+// io_thread: Owns the port, services the submission queue
+//-------------------------------------------------------------
+void ftdi_axi_async::io_thread(void)
+{
+    Request *carry = NULL;
+
+    while (true)
+    {
+        if (!carry)
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [this] { return m_pending.load() > 0 || !m_running.load(); });
+
+            if (!m_running.load() && m_pending.load() == 0)
+                break;
+        }
+
+        // Stale responses must not reach the next batch
+        if (!process(carry))
+            m_batch.resync(m_port, m_read_buf, ASYNC_TIMEOUT_MS);
+    }
+}
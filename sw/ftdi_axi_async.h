@@ -0,0 +1,100 @@
+#ifndef FTDI_AXI_ASYNC_H
+#define FTDI_AXI_ASYNC_H
+
+#include <stdint.h>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "ftdi_driver_api.h"
+#include "ftdi_axi_batch.h"
+
+//-------------------------------------------------------------
+// ftdi_axi_async: Asynchronous transaction engine
+//
+// Any number of threads submit operations through a lock-free
+// queue. A dedicated I/O thread (the only user of the port) drains
+// the queue, frames everything pending into one OUT transfer, and
+// completes each operation from the response stream (matched by
+// sequence number) via a future or callback. After a failed
+// transfer the link is drained before the next batch is sent.
+//-------------------------------------------------------------
+class ftdi_axi_async
+{
+public:
+    typedef void (*tCallback)(void *ctx, bool ok, uint32_t value);
+
+    ftdi_axi_async(ftdi_driver_api *port, int chunk_size = 512);
+    ~ftdi_axi_async();
+
+    bool start(void);
+    void stop(void);
+
+    // Result pointers / buffers must stay valid until completion.
+    // Block read()/write() address and length must be word aligned;
+    // anything else completes with false without being issued.
+    std::future<bool> read32(uint32_t addr, uint32_t *data);
+    std::future<bool> write32(uint32_t addr, uint32_t data, bool posted = false);
+    std::future<bool> read(uint32_t addr, uint8_t *data, int length);
+    std::future<bool> write(uint32_t addr, uint8_t *data, int length, bool posted = false);
+    std::future<bool> gpio_write(uint32_t value);
+    std::future<bool> gpio_read(uint32_t *value);
+
+    // Callback flavour (called on the I/O thread)
+    bool submit(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value, tCallback cb, void *ctx);
+
+    // Statistics
+    uint64_t get_ops(void)       { return m_stat_ops; }
+    uint64_t get_transfers(void) { return m_stat_transfers; }
+
+protected:
+    struct Request
+    {
+        std::atomic<Request*> next;
+        uint8_t               cmd_id;
+        uint32_t              addr;
+        uint8_t              *data;
+        int                   length;
+        uint32_t              value;
+        uint32_t             *result;
+        std::promise<bool>   *promise;
+        tCallback             cb;
+        void                 *ctx;
+    };
+
+    std::future<bool> submit_future(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value, uint32_t *result);
+    void     push(Request *req);
+    Request *pop(void);
+    void     complete(Request *req, bool ok, uint32_t value);
+    void     io_thread(void);
+    bool     process(Request *&carry);
+
+    ftdi_driver_api        *m_port;
+    ftdi_axi_batch          m_batch;
+    uint16_t                m_seq_num;
+    uint8_t                *m_write_buf;
+    uint8_t                *m_read_buf;
+
+    // Multi-producer / single-consumer queue (intrusive, lock-free)
+    std::atomic<Request*>   m_head;
+    Request                *m_tail;
+    Request                 m_stub;
+    std::atomic<int>        m_pending;
+
+    // I/O thread wakeup
+    std::mutex              m_lock;
+    std::condition_variable m_wake;
+    std::atomic<bool>       m_running;
+    std::thread             m_thread;
+
+    std::atomic<uint64_t>   m_stat_ops;
+    std::atomic<uint64_t>   m_stat_transfers;
+
+private:
+    ftdi_axi_async(const ftdi_axi_async &);
+    ftdi_axi_async &operator=(const ftdi_axi_async &);
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "ftdi_axi_batch.h"
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_protocol.h"
+
+#define BATCH_FLUSH_MS    10
+#define BATCH_DRAIN_US    10000
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_axi_batch::ftdi_axi_batch(int chunk_size)
+{
+    chunk_size &= ~3;
+    if (chunk_size < 4)
+        chunk_size = 4;
+    else if (chunk_size > MAX_CHUNK_SIZE)
+        chunk_size = MAX_CHUNK_SIZE;
+
+    m_chunk_size = chunk_size;
+    clear();
+}
+//-------------------------------------------------------------
+// clear: Remove all operations
+//-------------------------------------------------------------
+void ftdi_axi_batch::clear(void)
+{
+    m_count     = 0;
+    m_out_len   = 0;
+    m_resp_len  = 0;
+    m_resp_cmds = 0;
+}
+//-------------------------------------------------------------
+// op_commands: Number of commands an operation is framed as
+//-------------------------------------------------------------
+int ftdi_axi_batch::op_commands(const tAxiOp *op)
+{
+    switch (op->cmd_id)
+    {
+    case CMD_ID_READ:
+    case CMD_ID_WRITE:
+    case CMD_ID_WRITE_NP:
+        return (op->length + m_chunk_size - 1) / m_chunk_size;
+    default:
+        return 1;
+    }
+}
+//-------------------------------------------------------------
+// op_out_length: OUT bytes for an operation
+//-------------------------------------------------------------
+int ftdi_axi_batch::op_out_length(const tAxiOp *op)
+{
+    int hdr = sizeof(tCommandBlock) * op_commands(op);
+
+    switch (op->cmd_id)
+    {
+    case CMD_ID_READ:
+    case CMD_ID_GPIO_RD:
+        return hdr;
+    default:
+        return hdr + op->length;
+    }
+}
+//-------------------------------------------------------------
+// op_resp_length: IN bytes for an operation
+//-------------------------------------------------------------
+int ftdi_axi_batch::op_resp_length(const tAxiOp *op, int &resp_cmds)
+{
+    switch (op->cmd_id)
+    {
+    case CMD_ID_READ:
+        resp_cmds = op_commands(op);
+        return op->length + (resp_cmds * sizeof(tStatusBlock));
+    case CMD_ID_ECHO:
+    case CMD_ID_GPIO_RD:
+        resp_cmds = 1;
+        return op->length + sizeof(tStatusBlock);
+    case CMD_ID_WRITE8_NP:
+    case CMD_ID_WRITE16_NP:
+    case CMD_ID_WRITE_NP:
+    case CMD_ID_GPIO_WR:
+        resp_cmds = 1;
+        return sizeof(tStatusBlock);
+    default:
+        resp_cmds = 0;
+        return 0;
+    }
+}
+//-------------------------------------------------------------
+// add: Append an operation. Returns its index, or -1 if the batch
+// is full (or the operation is invalid).
+//-------------------------------------------------------------
+int ftdi_axi_batch::add(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value, void *ctx)
+{
+    if (m_count >= BATCH_MAX_OPS)
+        return -1;
+
+    tAxiOp *op = &m_ops[m_count];
+    op->cmd_id   = cmd_id;
+    op->addr     = addr;
+    op->data     = data;
+    op->length   = length;
+    op->value    = value;
+    op->ctx      = ctx;
+    op->ok       = false;
+    op->status   = 0;
+    op->seq_num  = 0;
+
+    switch (cmd_id)
+    {
+    case CMD_ID_READ:
+    case CMD_ID_WRITE:
+    case CMD_ID_WRITE_NP:
+        if ((addr & 3) || (length & 3) || length <= 0 || (!data && length != 4))
+            return -1;
+        break;
+    case CMD_ID_ECHO:
+        if ((length & 3) || length < 0 || (length / 4) > CMD_MAX_WORDS || (length && !data))
+            return -1;
+        break;
+    case CMD_ID_WRITE8:
+    case CMD_ID_WRITE8_NP:
+    case CMD_ID_WRITE16:
+    case CMD_ID_WRITE16_NP:
+    case CMD_ID_GPIO_WR:
+    case CMD_ID_GPIO_RD:
+        op->data   = NULL;
+        op->length = 4;
+        break;
+    default:
+        return -1;
+    }
+
+    op->commands = op_commands(op);
+
+    // Keep within the transfer buffers, and keep the number of
+    // response producing commands to one block batch so the commands
+    // always fit in the target RX FIFO while its TX side is stalled.
+    int resp_cmds = 0;
+    int out_len   = op_out_length(op);
+    int resp_len  = op_resp_length(op, resp_cmds);
+    if ((m_out_len + out_len) > WRITE_BUF_SIZE ||
+        (m_resp_len + resp_len) > READ_BUF_SIZE ||
+        (m_resp_cmds + resp_cmds) > MAX_BATCH_CHUNKS)
+        return -1;
+
+    m_out_len   += out_len;
+    m_resp_len  += resp_len;
+    m_resp_cmds += resp_cmds;
+    return m_count++;
+}
+//-------------------------------------------------------------
+// frame: Frame all operations into wr_buf, returns bytes
+//-------------------------------------------------------------
+int ftdi_axi_batch::frame(uint8_t *wr_buf, uint16_t &seq_num)
+{
+    uint8_t *p = wr_buf;
+
+    for (int i=0;i<m_count;i++)
+    {
+        tAxiOp  *op   = &m_ops[i];
+        uint8_t *src  = op->data ? op->data : (uint8_t *)&op->value;
+        int      left = op->length;
+
+        op->seq_num = seq_num;
+
+        for (int c=0;c<op->commands;c++)
+        {
+            int size = (left < m_chunk_size) ? left : m_chunk_size;
+
+            tCommandBlock *cmd = (tCommandBlock *)p;
+            cmd->command = op->cmd_id;
+            cmd->length  = size / 4;
+            cmd->seq_num = seq_num++;
+            cmd->addr    = op->addr + (c * m_chunk_size);
+            p += sizeof(tCommandBlock);
+
+            // Only the final command of a non-posted block write responds
+            if (op->cmd_id == CMD_ID_WRITE_NP && c != (op->commands - 1))
+                cmd->command = CMD_ID_WRITE;
+
+            if (op->cmd_id != CMD_ID_READ && op->cmd_id != CMD_ID_GPIO_RD)
+            {
+                memcpy(p, src, size);
+                p   += size;
+                src += size;
+            }
+            left -= size;
+        }
+    }
+
+    assert((p - wr_buf) == m_out_len);
+    return p - wr_buf;
+}
+//-------------------------------------------------------------
+// parse: Walk the response stream, completing each operation
+//-------------------------------------------------------------
+bool ftdi_axi_batch::parse(const uint8_t *rd_buf, int length)
+{
+    const uint8_t *p   = rd_buf;
+    const uint8_t *end = rd_buf + length;
+
+    for (int i=0;i<m_count;i++)
+    {
+        tAxiOp *op = &m_ops[i];
+        int resp_cmds = 0;
+        op_resp_length(op, resp_cmds);
+
+        // Posted - complete once sent
+        if (resp_cmds == 0)
+        {
+            op->ok = true;
+            continue;
+        }
+
+        uint8_t *dst  = op->data ? op->data : (uint8_t *)&op->value;
+        int      left = (op->cmd_id == CMD_ID_READ || op->cmd_id == CMD_ID_GPIO_RD ||
+                         op->cmd_id == CMD_ID_ECHO) ? op->length : 0;
+
+        for (int c=0;c<resp_cmds;c++)
+        {
+            int size = (left < m_chunk_size) ? left : m_chunk_size;
+            if ((p + size + (int)sizeof(tStatusBlock)) > end)
+            {
+                fprintf(stderr, "ERROR: Batch response underflow\n");
+                return false;
+            }
+
+            // ECHO data is checked by the caller if required
+            if (op->cmd_id != CMD_ID_ECHO)
+            {
+                memcpy(dst, p, size);
+                dst += size;
+            }
+            p    += size;
+            left -= size;
+
+            // Responses arrive in command order - the status seq_num
+            // identifies which command (and so which operation) it is.
+            const tStatusBlock *sts = (const tStatusBlock *)p;
+            uint16_t seq_num = op->seq_num + (op->commands - resp_cmds) + c;
+            if (sts->seq_num != seq_num)
+            {
+                fprintf(stderr, "ERROR: Sequence number: %04x != %04x\n", sts->seq_num, seq_num);
+                return false;
+            }
+            op->status = sts->status;
+            p += sizeof(tStatusBlock);
+        }
+
+        op->ok = true;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// transact: Issue the batch as one OUT transfer and collect the
+// whole response stream (buffers sized WRITE_BUF_SIZE/READ_BUF_SIZE)
+//-------------------------------------------------------------
+bool ftdi_axi_batch::transact(ftdi_driver_api *port, uint8_t *wr_buf, uint8_t *rd_buf, uint16_t &seq_num, int timeout_ms)
+{
+    int wr_len = frame(wr_buf, seq_num);
+    if (port->write(wr_buf, wr_len, timeout_ms) != wr_len)
+    {
+        fprintf(stderr, "ERROR: Batch write failed\n");
+        return false;
+    }
+
+    int rd_len = 0;
+    while (rd_len < m_resp_len)
+    {
+        int len = port->read(&rd_buf[rd_len], m_resp_len - rd_len, timeout_ms);
+        if (len <= 0)
+        {
+            fprintf(stderr, "ERROR: Batch response underflow (got %d, expected %d)\n", rd_len, m_resp_len);
+            return false;
+        }
+        rd_len += len;
+    }
+
+    return parse(rd_buf, rd_len);
+}
+//-------------------------------------------------------------
+// resync: Unread responses would otherwise be parsed as the next
+// batch's: send a drain burst (as send_drain) and read the IN pipe
+// until it stays empty.
+//-------------------------------------------------------------
+void ftdi_axi_batch::resync(ftdi_driver_api *port, uint8_t *rd_buf, int timeout_ms)
+{
+    uint8_t drain[256];
+    memset(drain, CMD_ID_DRAIN, sizeof(drain));
+    port->write(drain, sizeof(drain), timeout_ms);
+    port->sleep(BATCH_DRAIN_US);
+
+    while (port->read(rd_buf, READ_BUF_SIZE, BATCH_FLUSH_MS) > 0)
+        ;
+}
@@ -0,0 +1,71 @@
+#ifndef FTDI_AXI_BATCH_H
+#define FTDI_AXI_BATCH_H
+
+#include <stdint.h>
+#include "ftdi_driver_api.h"
+
+#define BATCH_MAX_OPS   512
+
+//-------------------------------------------------------------
+// tAxiOp: One operation within a batch
+//-------------------------------------------------------------
+typedef struct AxiOp
+{
+    uint8_t   cmd_id;     // CMD_ID_xxx
+    uint32_t  addr;
+    uint8_t  *data;       // Block source / destination (NULL: use value)
+    int       length;     // Bytes (multiple of 4)
+    uint32_t  value;      // Single word data / result
+    void     *ctx;        // Owner context
+
+    // Result
+    bool      ok;
+    uint16_t  status;     // Last status word (AXI resp)
+
+    // Private
+    uint16_t  seq_num;    // First command seq_num
+    int       commands;
+} tAxiOp;
+
+//-------------------------------------------------------------
+// ftdi_axi_batch: Frames an ordered list of operations into one
+// OUT transfer and parses the concatenated response stream.
+//-------------------------------------------------------------
+class ftdi_axi_batch
+{
+public:
+    ftdi_axi_batch(int chunk_size = 512);
+
+    void    clear(void);
+    int     add(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value = 0, void *ctx = 0);
+
+    int     count(void)            { return m_count; }
+    tAxiOp &op(int idx)            { return m_ops[idx]; }
+    int     out_length(void)       { return m_out_len; }
+    int     resp_length(void)      { return m_resp_len; }
+
+    int     frame(uint8_t *wr_buf, uint16_t &seq_num);
+    bool    parse(const uint8_t *rd_buf, int length);
+
+    // Frame, send, receive and parse in one round trip
+    bool    transact(ftdi_driver_api *port, uint8_t *wr_buf, uint8_t *rd_buf, uint16_t &seq_num, int timeout_ms);
+
+    // Recover the link after a failed transact(): reset the target
+    // command parser and discard unread responses (rd_buf is scratch)
+    void    resync(ftdi_driver_api *port, uint8_t *rd_buf, int timeout_ms);
+
+protected:
+    int     op_commands(const tAxiOp *op);
+    int     op_out_length(const tAxiOp *op);
+    int     op_resp_length(const tAxiOp *op, int &resp_cmds);
+
+    int     m_chunk_size;
+    tAxiOp  m_ops[BATCH_MAX_OPS];
+    int     m_count;
+
+    int     m_out_len;
+    int     m_resp_len;
+    int     m_resp_cmds;
+};
+
+#endif
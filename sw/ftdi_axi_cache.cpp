@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <string.h>
+#include "ftdi_axi_cache.h"
+
+#define LINE_BASE(_a)   ((_a) & ~(uint32_t)(CACHE_LINE_SIZE - 1))
+#define LINE_SET(_a)    (((_a) / CACHE_LINE_SIZE) % CACHE_SETS)
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_axi_cache::ftdi_axi_cache()
+{
+    m_stamp = 0;
+    clear_regions();
+}
+//-------------------------------------------------------------
+// add_region: Declare the attribute of an address range
+//-------------------------------------------------------------
+bool ftdi_axi_cache::add_region(uint32_t base, uint32_t size, int attr)
+{
+    uint64_t end = (uint64_t)base + size;
+
+    if (size == 0 || attr < AXI_REGION_UNCACHED || attr > AXI_REGION_WRITE_THROUGH)
+    {
+        fprintf(stderr, "ERROR: Invalid region %08x+%x\n", base, size);
+        return false;
+    }
+
+    if (attr != AXI_REGION_UNCACHED && ((base | size) & (CACHE_LINE_SIZE - 1)))
+    {
+        fprintf(stderr, "ERROR: Cacheable region %08x+%x not %d byte aligned\n", base, size, CACHE_LINE_SIZE);
+        return false;
+    }
+
+    if (m_region_count >= MAX_AXI_REGIONS)
+    {
+        fprintf(stderr, "ERROR: Too many regions\n");
+        return false;
+    }
+
+    for (int i=0;i<m_region_count;i++)
+        if (base < m_regions[i].end && end > m_regions[i].base)
+        {
+            fprintf(stderr, "ERROR: Region %08x+%x overlaps an existing region\n", base, size);
+            return false;
+        }
+
+    tRegion *r = &m_regions[m_region_count++];
+    r->base = base;
+    r->end  = end;
+    r->attr = attr;
+
+    if (attr != AXI_REGION_UNCACHED)
+        m_cacheable = true;
+
+    return true;
+}
+//-------------------------------------------------------------
+// clear_regions: Remove all regions (and cached lines)
+//-------------------------------------------------------------
+void ftdi_axi_cache::clear_regions(void)
+{
+    m_region_count = 0;
+    m_cacheable    = false;
+    invalidate_all();
+}
+//-------------------------------------------------------------
+// region_attr: Attribute for a range
+//-------------------------------------------------------------
+int ftdi_axi_cache::region_attr(uint32_t addr, int length)
+{
+    uint64_t end = (uint64_t)addr + length;
+
+    for (int i=0;i<m_region_count;i++)
+        if (addr >= m_regions[i].base && addr < m_regions[i].end)
+            return (end <= m_regions[i].end) ? m_regions[i].attr : AXI_REGION_UNCACHED;
+
+    return AXI_REGION_UNCACHED;
+}
+//-------------------------------------------------------------
+// find_line: Look up a line (NULL if not present)
+//-------------------------------------------------------------
+ftdi_axi_cache::tCacheLine *ftdi_axi_cache::find_line(uint32_t line_addr)
+{
+    tCacheLine *set = m_lines[LINE_SET(line_addr)];
+
+    for (int w=0;w<CACHE_WAYS;w++)
+        if (set[w].valid && set[w].addr == line_addr)
+            return &set[w];
+
+    return NULL;
+}
+//-------------------------------------------------------------
+// lookup: Serve a read from the cache if every line is present
+//-------------------------------------------------------------
+bool ftdi_axi_cache::lookup(uint32_t addr, uint8_t *data, int length)
+{
+    uint64_t end = (uint64_t)addr + length;
+
+    // Check first so a partial hit leaves nothing half copied
+    for (uint64_t line = LINE_BASE(addr); line < end; line += CACHE_LINE_SIZE)
+        if (!find_line((uint32_t)line))
+            return false;
+
+    while (length > 0)
+    {
+        tCacheLine *l    = find_line(LINE_BASE(addr));
+        int         offs = addr & (CACHE_LINE_SIZE - 1);
+        int         size = CACHE_LINE_SIZE - offs;
+        if (size > length)
+            size = length;
+
+        memcpy(data, &l->data[offs], size);
+        l->stamp = ++m_stamp;
+        addr   += size;
+        data   += size;
+        length -= size;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// fill: Install lines (addr and length line aligned), replacing
+// the least recently used way of each set.
+//-------------------------------------------------------------
+void ftdi_axi_cache::fill(uint32_t addr, const uint8_t *data, int length)
+{
+    for (int offset=0;offset<length;offset+=CACHE_LINE_SIZE)
+    {
+        uint32_t    line_addr = addr + offset;
+        tCacheLine *l         = find_line(line_addr);
+
+        if (!l)
+        {
+            tCacheLine *set = m_lines[LINE_SET(line_addr)];
+            l = &set[0];
+            for (int w=0;w<CACHE_WAYS;w++)
+            {
+                if (!set[w].valid)
+                {
+                    l = &set[w];
+                    break;
+                }
+                if (set[w].stamp < l->stamp)
+                    l = &set[w];
+            }
+        }
+
+        l->valid = true;
+        l->addr  = line_addr;
+        l->stamp = ++m_stamp;
+        memcpy(l->data, &data[offset], CACHE_LINE_SIZE);
+    }
+}
+//-------------------------------------------------------------
+// write: Keep present lines coherent with a write. Lines are only
+// filled within cacheable regions, so only the part of the range
+// overlapping one of those is walked.
+//-------------------------------------------------------------
+void ftdi_axi_cache::write(uint32_t addr, const uint8_t *data, int length)
+{
+    uint64_t end = (uint64_t)addr + length;
+
+    for (int i=0;i<m_region_count;i++)
+    {
+        tRegion *r = &m_regions[i];
+        if (r->attr == AXI_REGION_UNCACHED || addr >= r->end || end <= r->base)
+            continue;
+
+        uint64_t first = (addr > r->base) ? addr : r->base;
+        uint64_t last  = (end < r->end) ? end : r->end;
+        write_lines((uint32_t)first, data ? data + (first - addr) : NULL, (int)(last - first), r->attr);
+    }
+}
+//-------------------------------------------------------------
+// write_lines: Update / drop the present lines of a range within
+// one region
+//-------------------------------------------------------------
+void ftdi_axi_cache::write_lines(uint32_t addr, const uint8_t *data, int length, int attr)
+{
+    while (length > 0)
+    {
+        uint32_t line = LINE_BASE(addr);
+        int      offs = addr & (CACHE_LINE_SIZE - 1);
+        int      size = CACHE_LINE_SIZE - offs;
+        if (size > length)
+            size = length;
+
+        tCacheLine *l = find_line(line);
+        if (l)
+        {
+            if (data && attr == AXI_REGION_WRITE_THROUGH)
+                memcpy(&l->data[offs], data, size);
+            else
+                l->valid = false;
+        }
+
+        addr   += size;
+        length -= size;
+        if (data)
+            data += size;
+    }
+}
+//-------------------------------------------------------------
+// invalidate: Drop the lines covering a range
+//-------------------------------------------------------------
+void ftdi_axi_cache::invalidate(uint32_t addr, uint32_t length)
+{
+    uint64_t end = (uint64_t)addr + length;
+
+    for (int s=0;s<CACHE_SETS;s++)
+        for (int w=0;w<CACHE_WAYS;w++)
+        {
+            tCacheLine *l = &m_lines[s][w];
+            if (l->valid && (l->addr + (uint64_t)CACHE_LINE_SIZE) > addr && l->addr < end)
+                l->valid = false;
+        }
+}
+//-------------------------------------------------------------
+// invalidate_all: Drop every line
+//-------------------------------------------------------------
+void ftdi_axi_cache::invalidate_all(void)
+{
+    for (int s=0;s<CACHE_SETS;s++)
+        for (int w=0;w<CACHE_WAYS;w++)
+            m_lines[s][w].valid = false;
+}
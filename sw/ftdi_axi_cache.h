@@ -0,0 +1,86 @@
+#ifndef FTDI_AXI_CACHE_H
+#define FTDI_AXI_CACHE_H
+
+#include <stdint.h>
+
+// Address region attributes
+#define AXI_REGION_UNCACHED      0   // Every access goes to the target
+#define AXI_REGION_CACHED        1   // Reads cached, writes invalidate
+#define AXI_REGION_WRITE_THROUGH 2   // Reads cached, writes update
+
+#define MAX_AXI_REGIONS          16
+
+// Host line cache (set associative, LRU)
+#define CACHE_LINE_SIZE          64
+#define CACHE_SETS               64
+#define CACHE_WAYS               4
+
+// Largest read which allocates (one burst read fill)
+#define CACHE_FILL_MAX           4096
+
+//-------------------------------------------------------------
+// ftdi_axi_cache: Address region attribute map and the host side
+// line cache for the cacheable regions. Cacheable regions must be
+// line aligned so a line fill never touches an address outside
+// the region.
+//-------------------------------------------------------------
+class ftdi_axi_cache
+{
+public:
+    ftdi_axi_cache();
+
+    bool add_region(uint32_t base, uint32_t size, int attr);
+    void clear_regions(void);
+
+    // Any cacheable regions declared
+    bool active(void) { return m_cacheable; }
+
+    // Attribute of a range (uncached unless it lies within one region)
+    int  region_attr(uint32_t addr, int length);
+
+    // Copy out a range if every line is present
+    bool lookup(uint32_t addr, uint8_t *data, int length);
+
+    // Install whole lines read from the target
+    void fill(uint32_t addr, const uint8_t *data, int length);
+
+    // Apply a write to the target: update (write-through) or drop
+    // (cached) the lines it touches
+    void write(uint32_t addr, const uint8_t *data, int length);
+
+    void invalidate(uint32_t addr, uint32_t length);
+    void invalidate_all(void);
+
+    // Line aligned fill buffer (CACHE_FILL_MAX bytes)
+    uint8_t *fill_buffer(void) { return m_fill_buf; }
+
+protected:
+    typedef struct Region
+    {
+        uint32_t base;
+        uint64_t end;
+        int      attr;
+    } tRegion;
+
+    typedef struct CacheLine
+    {
+        bool     valid;
+        uint32_t addr;
+        uint32_t stamp;
+        uint8_t  data[CACHE_LINE_SIZE];
+    } tCacheLine;
+
+    tCacheLine *find_line(uint32_t line_addr);
+    void        write_lines(uint32_t addr, const uint8_t *data, int length, int attr);
+
+    tRegion    m_regions[MAX_AXI_REGIONS];
+    int        m_region_count;
+    bool       m_cacheable;
+
+    tCacheLine m_lines[CACHE_SETS][CACHE_WAYS];
+    uint32_t   m_stamp;
+
+    uint8_t    m_fill_buf[CACHE_FILL_MAX];
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ftdi_axi_coro.h"
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_protocol.h"
+
+#define CORO_TIMEOUT_MS  1000
+
+//-------------------------------------------------------------
+// ftdi_axi_awaiter
+//-------------------------------------------------------------
+ftdi_axi_awaiter::ftdi_axi_awaiter(ftdi_axi_loop *loop, uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value)
+{
+    m_loop   = loop;
+    m_cmd_id = cmd_id;
+    m_addr   = addr;
+    m_data   = data;
+    m_length = length;
+    m_value  = value;
+
+    m_result.ok     = false;
+    m_result.value  = 0;
+    m_result.status = 0;
+}
+//-------------------------------------------------------------
+// await_suspend: Park the coroutine until the next dispatch
+//-------------------------------------------------------------
+void ftdi_axi_awaiter::await_suspend(std::coroutine_handle<> h)
+{
+    m_handle = h;
+    m_loop->enqueue(this);
+}
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_axi_loop::ftdi_axi_loop(ftdi_driver_api *port, int chunk_size): m_batch(chunk_size)
+{
+    m_port           = port;
+    m_seq_num        = 1;
+    m_write_buf      = (uint8_t *)malloc(WRITE_BUF_SIZE);
+    m_read_buf       = (uint8_t *)malloc(READ_BUF_SIZE);
+    m_stat_ops       = 0;
+    m_stat_transfers = 0;
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_axi_loop::~ftdi_axi_loop()
+{
+    // Suspended operations belong to the frames destroyed below
+    m_waiting.clear();
+    for (size_t i=0;i<m_tasks.size();i++)
+        m_tasks[i].destroy();
+
+    free(m_write_buf);
+    free(m_read_buf);
+}
+//-------------------------------------------------------------
+// spawn: Take ownership of a coroutine, started by run()
+//-------------------------------------------------------------
+void ftdi_axi_loop::spawn(ftdi_axi_task &&task)
+{
+    if (!task.m_handle)
+        return;
+
+    m_tasks.push_back(task.m_handle);
+    m_ready.push_back(task.m_handle);
+    task.m_handle = nullptr;
+}
+//-------------------------------------------------------------
+// run: Run until every spawned coroutine has finished.
+// Returns false if any transfer failed; operations awaited after
+// the failure complete at once with ok = false, and the link is
+// resynchronised for the next run().
+//-------------------------------------------------------------
+bool ftdi_axi_loop::run(void)
+{
+    bool ok = (m_write_buf != NULL && m_read_buf != NULL);
+    std::vector<std::coroutine_handle<> > ready;
+
+    while (ok)
+    {
+        // Let everything runnable advance to its next suspension
+        while (!m_ready.empty())
+        {
+            ready.swap(m_ready);
+            for (size_t i=0;i<ready.size();i++)
+                ready[i].resume();
+            ready.clear();
+        }
+
+        if (m_waiting.empty())
+            break;
+
+        ok = dispatch();
+    }
+
+    // Unread responses of the failed batch must not be taken as
+    // replies to the next run()
+    if (!ok && m_write_buf && m_read_buf)
+        m_batch.resync(m_port, m_read_buf, CORO_TIMEOUT_MS);
+
+    // Nothing more is issued after a failed transfer: fail whatever
+    // is still waiting, so every coroutine sees the error and runs on
+    // to completion (or to its next operation, which fails too).
+    while (!ok && (!m_ready.empty() || !m_waiting.empty()))
+    {
+        while (!m_waiting.empty())
+        {
+            ftdi_axi_awaiter *op = m_waiting.front();
+            op->m_result.ok = false;
+            m_ready.push_back(op->m_handle);
+            m_waiting.pop_front();
+        }
+
+        ready.swap(m_ready);
+        for (size_t i=0;i<ready.size();i++)
+            ready[i].resume();
+        ready.clear();
+    }
+
+    // Reap finished coroutines
+    for (size_t i=0;i<m_tasks.size();)
+    {
+        if (m_tasks[i].done())
+        {
+            m_tasks[i].destroy();
+            m_tasks.erase(m_tasks.begin() + i);
+        }
+        else
+            i++;
+    }
+
+    return ok;
+}
+//-------------------------------------------------------------
+// dispatch: Issue waiting operations as one batch, queue the
+// owning coroutines to be resumed.
+//-------------------------------------------------------------
+bool ftdi_axi_loop::dispatch(void)
+{
+    m_batch.clear();
+
+    while (!m_waiting.empty())
+    {
+        ftdi_axi_awaiter *op = m_waiting.front();
+        if (m_batch.add(op->m_cmd_id, op->m_addr, op->m_data, op->m_length, op->m_value, op) < 0)
+        {
+            // Left for the next batch, unless it can never be issued
+            if (m_batch.count() != 0)
+                break;
+
+            op->m_result.ok = false;
+            m_ready.push_back(op->m_handle);
+        }
+        m_waiting.pop_front();
+    }
+
+    if (m_batch.count() == 0)
+        return true;
+
+    bool ok = m_batch.transact(m_port, m_write_buf, m_read_buf, m_seq_num, CORO_TIMEOUT_MS);
+
+    for (int i=0;i<m_batch.count();i++)
+    {
+        tAxiOp &op = m_batch.op(i);
+        ftdi_axi_awaiter *awaiter = (ftdi_axi_awaiter *)op.ctx;
+
+        awaiter->m_result.ok     = ok && op.ok;
+        awaiter->m_result.value  = op.value;
+        awaiter->m_result.status = op.status;
+        m_ready.push_back(awaiter->m_handle);
+    }
+
+    m_stat_ops += m_batch.count();
+    m_stat_transfers++;
+    return ok;
+}
+//-------------------------------------------------------------
+// Awaitables
+//-------------------------------------------------------------
+ftdi_axi_awaiter ftdi_axi_loop::read32(uint32_t addr)
+{
+    return ftdi_axi_awaiter(this, CMD_ID_READ, addr, NULL, 4, 0);
+}
+ftdi_axi_awaiter ftdi_axi_loop::write32(uint32_t addr, uint32_t data, bool posted)
+{
+    return ftdi_axi_awaiter(this, posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, NULL, 4, data);
+}
+ftdi_axi_awaiter ftdi_axi_loop::read(uint32_t addr, uint8_t *data, int length)
+{
+    return ftdi_axi_awaiter(this, CMD_ID_READ, addr, data, length, 0);
+}
+ftdi_axi_awaiter ftdi_axi_loop::write(uint32_t addr, uint8_t *data, int length, bool posted)
+{
+    return ftdi_axi_awaiter(this, posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, data, length, 0);
+}
+ftdi_axi_awaiter ftdi_axi_loop::gpio_write(uint32_t value)
+{
+    return ftdi_axi_awaiter(this, CMD_ID_GPIO_WR, 0, NULL, 4, value);
+}
+ftdi_axi_awaiter ftdi_axi_loop::gpio_read(void)
+{
+    return ftdi_axi_awaiter(this, CMD_ID_GPIO_RD, 0, NULL, 4, 0);
+}
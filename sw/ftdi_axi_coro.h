@@ -0,0 +1,136 @@
+#ifndef FTDI_AXI_CORO_H
+#define FTDI_AXI_CORO_H
+
+#include <stdint.h>
+#include <coroutine>
+#include <deque>
+#include <vector>
+
+#include "ftdi_driver_api.h"
+#include "ftdi_axi_batch.h"
+
+class ftdi_axi_loop;
+
+//-------------------------------------------------------------
+// tAxiResult: Result of an awaited operation
+//-------------------------------------------------------------
+typedef struct AxiResult
+{
+    bool     ok;
+    uint32_t value;     // read32 / gpio_read data
+    uint16_t status;    // AXI response
+} tAxiResult;
+
+//-------------------------------------------------------------
+// ftdi_axi_task: Coroutine handed to ftdi_axi_loop::spawn
+//-------------------------------------------------------------
+class ftdi_axi_task
+{
+public:
+    struct promise_type
+    {
+        ftdi_axi_task get_return_object(void)
+        {
+            return ftdi_axi_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend(void) noexcept { return {}; }
+        std::suspend_always final_suspend(void) noexcept { return {}; }
+        void return_void(void) { }
+        void unhandled_exception(void) { throw; }
+    };
+
+    ftdi_axi_task(ftdi_axi_task &&other): m_handle(other.m_handle) { other.m_handle = nullptr; }
+    ~ftdi_axi_task() { if (m_handle) m_handle.destroy(); }
+
+    bool done(void) { return !m_handle || m_handle.done(); }
+
+private:
+    friend class ftdi_axi_loop;
+
+    explicit ftdi_axi_task(std::coroutine_handle<promise_type> h): m_handle(h) { }
+    ftdi_axi_task(const ftdi_axi_task &);
+    ftdi_axi_task &operator=(const ftdi_axi_task &);
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+//-------------------------------------------------------------
+// ftdi_axi_awaiter: One suspended operation
+//-------------------------------------------------------------
+class ftdi_axi_awaiter
+{
+public:
+    ftdi_axi_awaiter(ftdi_axi_loop *loop, uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, uint32_t value);
+
+    bool       await_ready(void) { return false; }
+    void       await_suspend(std::coroutine_handle<> h);
+    tAxiResult await_resume(void) { return m_result; }
+
+private:
+    friend class ftdi_axi_loop;
+
+    ftdi_axi_loop          *m_loop;
+    uint8_t                 m_cmd_id;
+    uint32_t                m_addr;
+    uint8_t                *m_data;
+    int                     m_length;
+    uint32_t                m_value;
+    tAxiResult              m_result;
+    std::coroutine_handle<> m_handle;
+};
+
+//-------------------------------------------------------------
+// ftdi_axi_loop: Single threaded event loop
+//
+// Runs spawned coroutines until they all suspend, frames the
+// operations they are waiting on into one OUT transfer, then
+// resumes each as its response (matched by sequence number) is
+// parsed. Logically concurrent register sequences therefore share
+// round trips without any threads.
+//-------------------------------------------------------------
+class ftdi_axi_loop
+{
+public:
+    ftdi_axi_loop(ftdi_driver_api *port, int chunk_size = 512);
+    ~ftdi_axi_loop();
+
+    void spawn(ftdi_axi_task &&task);
+    bool run(void);
+
+    // Awaitables (buffers must stay valid until resumed)
+    ftdi_axi_awaiter read32(uint32_t addr);
+    ftdi_axi_awaiter write32(uint32_t addr, uint32_t data, bool posted = false);
+    ftdi_axi_awaiter read(uint32_t addr, uint8_t *data, int length);
+    ftdi_axi_awaiter write(uint32_t addr, uint8_t *data, int length, bool posted = false);
+    ftdi_axi_awaiter gpio_write(uint32_t value);
+    ftdi_axi_awaiter gpio_read(void);
+
+    // Statistics
+    uint64_t get_ops(void)       { return m_stat_ops; }
+    uint64_t get_transfers(void) { return m_stat_transfers; }
+
+protected:
+    friend class ftdi_axi_awaiter;
+
+    void enqueue(ftdi_axi_awaiter *op) { m_waiting.push_back(op); }
+    bool dispatch(void);
+
+    ftdi_driver_api                              *m_port;
+    ftdi_axi_batch                                m_batch;
+    uint16_t                                      m_seq_num;
+    uint8_t                                      *m_write_buf;
+    uint8_t                                      *m_read_buf;
+
+    std::vector<std::coroutine_handle<ftdi_axi_task::promise_type> > m_tasks;
+    std::deque<ftdi_axi_awaiter *>                m_waiting;
+    std::vector<std::coroutine_handle<> >         m_ready;
+
+    uint64_t                                      m_stat_ops;
+    uint64_t                                      m_stat_transfers;
+
+private:
+    ftdi_axi_loop(const ftdi_axi_loop &);
+    ftdi_axi_loop &operator=(const ftdi_axi_loop &);
+};
+
+#endif
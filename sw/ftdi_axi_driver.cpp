@@ -1,36 +1,22 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
 #include "ftdi_axi_driver.h"
-
-typedef struct CommandBlock
-{
-    uint8_t  command;
-    uint8_t  length;
-    uint16_t seq_num;
-    uint32_t addr;
-} tCommandBlock;
-
-typedef struct StatusBlock
-{
-    uint16_t seq_num;
-    uint16_t status;
-} tStatusBlock;
-
-#define CMD_ID_ECHO       0x01
-#define CMD_ID_DRAIN      0x02
-#define CMD_ID_READ       0x10
-#define CMD_ID_WRITE8_NP  0x20 // 8-bit write (with response)
-#define CMD_ID_WRITE16_NP 0x21 // 16-bit write (with response)
-#define CMD_ID_WRITE_NP   0x22 // 32-bit write (with response)
-#define CMD_ID_WRITE8     0x30 // 8-bit write
-#define CMD_ID_WRITE16    0x31 // 16-bit write
-#define CMD_ID_WRITE      0x32 // 32-bit write
-#define CMD_ID_GPIO_WR    0x40
-#define CMD_ID_GPIO_RD    0x41
+#include "ftdi_axi_batch.h"
+#include "ftdi_axi_protocol.h"
 
 #define MAX_POSTED_WR     4096
 
+//-------------------------------------------------------------
+// pool_round: Round buffer size up to a whole number of pages
+//-------------------------------------------------------------
+static int pool_round(int size, int page_size)
+{
+    return ((size + page_size - 1) / page_size) * page_size;
+}
 //-------------------------------------------------------------
 // Constructor
 //-------------------------------------------------------------
@@ -38,6 +24,99 @@ ftdi_axi_driver::ftdi_axi_driver(ftdi_driver_api *port)
 {
     m_port    = port;
     m_seq_num = 1;  
+
+    m_wr_window        = DEFAULT_WR_WINDOW;
+    m_wr_pending_head  = 0;
+    m_wr_pending_count = 0;
+    m_wr_fence         = DEFAULT_WR_FENCE;
+
+    m_rd_depth         = DEFAULT_RD_DEPTH;
+    m_stream_reads     = false;
+    m_streaming        = false;
+
+    m_chunk_size       = DEFAULT_CHUNK_SIZE;
+    m_batch_chunks     = DEFAULT_BATCH_CHUNKS;
+
+    // Allocate all transfer buffers up front (page aligned) so that
+    // no register access or block transfer allocates on the hot path.
+    int page_size = (int)sysconf(_SC_PAGESIZE);
+    if (page_size <= 0)
+        page_size = 4096;
+
+    int cmd_size   = pool_round(CMD_BUF_SIZE, page_size);
+    int resp_size  = pool_round(RESP_BUF_SIZE, page_size);
+    int write_size = pool_round(WRITE_BUF_SIZE, page_size);
+    int read_size  = pool_round(READ_BUF_SIZE, page_size);
+
+    void *pool = NULL;
+    int pool_size = cmd_size + resp_size + write_size + (read_size * (MAX_RD_DEPTH + MAX_READ_VIEWS));
+    if (posix_memalign(&pool, page_size, pool_size) != 0)
+    {
+        fprintf(stderr, "ERROR: Failed to allocate transfer buffers\n");
+        abort();
+    }
+
+    m_pool      = (uint8_t*)pool;
+    m_cmd_buf   = m_pool;
+    m_resp_buf  = m_cmd_buf  + cmd_size;
+    m_write_buf = m_resp_buf + resp_size;
+
+    for (int i=0;i<MAX_RD_DEPTH;i++)
+        m_read_bufs[i] = m_write_buf + write_size + (i * read_size);
+
+    for (int i=0;i<MAX_READ_VIEWS;i++)
+    {
+        m_view_bufs[i] = m_read_bufs[MAX_RD_DEPTH-1] + ((i + 1) * read_size);
+        m_view_held[i] = false;
+    }
+    m_view_submitted = 0;
+    m_view_completed = 0;
+
+    m_wr_pos    = m_write_buf;
+
+    m_wc_max        = 0;
+    m_wc_timeout_us = DEFAULT_WC_TIMEOUT_US;
+    m_wc_pending    = false;
+    m_wc_bytes      = 0;
+    m_wc_start_ns   = 0;
+    m_wc_cmd        = NULL;
+
+    reset_stats();
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_axi_driver::~ftdi_axi_driver()
+{
+    // Posted writes still held for combining
+    if (m_wc_pending && !flush(100))
+        fprintf(stderr, "ERROR: Held posted writes lost on close\n");
+
+    free(m_pool);
+    m_pool = NULL;
+}
+//-------------------------------------------------------------
+// port_write / port_read: Transport access with accounting
+//-------------------------------------------------------------
+int ftdi_axi_driver::port_write(uint8_t *data, int length, int timeout_ms)
+{
+    int sent = m_port->write(data, length, timeout_ms);
+
+    m_stats.transfers_out++;
+    if (sent > 0)
+        m_stats.bytes_sent += sent;
+    return sent;
+}
+int ftdi_axi_driver::port_read(uint8_t *data, int length, int timeout_ms)
+{
+    int rd_len = m_port->read(data, length, timeout_ms);
+
+    m_stats.transfers_in++;
+    if (rd_len > 0)
+        m_stats.bytes_received += rd_len;
+    if (rd_len < length)
+        m_stats.short_reads++;
+    return rd_len;
 }
 //-------------------------------------------------------------
 // fill_command: Fill command with optional data into a buffer
@@ -63,6 +142,7 @@ int ftdi_axi_driver::fill_command(uint8_t *wr_buf, uint8_t cmd_id, uint32_t addr
         wr_len = sizeof(tCommandBlock);
 
     m_seq_num++;
+    m_stats.commands++;
     return wr_len;
 }
 //-------------------------------------------------------------
@@ -70,27 +150,8 @@ int ftdi_axi_driver::fill_command(uint8_t *wr_buf, uint8_t cmd_id, uint32_t addr
 //-------------------------------------------------------------
 bool ftdi_axi_driver::send_command(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, int timeout_ms)
 {
-    int            length4 = ((length + 3)/4) * 4;
-    uint8_t       *wr_buf  = new uint8_t[sizeof(tCommandBlock) + length4];
-    tCommandBlock *cmd     = (tCommandBlock*)wr_buf;
-    int            wr_len;
-
-    assert((length4 / 4) < 256);
-    cmd->command = cmd_id;
-    cmd->length  = length4 / 4;
-    cmd->seq_num = m_seq_num;
-    cmd->addr    = addr;
-
-    if (data && length)
-    {
-        memcpy(&wr_buf[sizeof(tCommandBlock)], data, length);
-        wr_len = sizeof(tCommandBlock) + length4;
-    }
-    else
-        wr_len = sizeof(tCommandBlock);
-
-    int sent = m_port->write(wr_buf, wr_len, timeout_ms);
-    delete []wr_buf;
+    int wr_len = fill_command(m_cmd_buf, cmd_id, addr, data, length);
+    int sent   = port_write(m_cmd_buf, wr_len, timeout_ms);
 
     bool ok = true;
     if (sent != wr_len)
@@ -99,51 +160,50 @@ bool ftdi_axi_driver::send_command(uint8_t cmd_id, uint32_t addr, uint8_t *data,
         ok = false;
     }
 
-    m_seq_num++;
     return ok;
 }
 //-------------------------------------------------------------
 // recv_data: Wait on response data
+// Returns a pointer into the response buffer (valid until the
+// next command) or NULL on failure.
 //-------------------------------------------------------------
 uint8_t* ftdi_axi_driver::recv_data(uint16_t seq_num, int length, int timeout_ms)
 {
-    bool     ok       = true;
     int      length4  = ((length + 3)/4) * 4;
     int      expected = sizeof(tStatusBlock) + length4;
-    uint8_t *rd_buf   = new uint8_t[expected];
-    int      rd_len   = m_port->read(rd_buf, expected, timeout_ms);
+    uint8_t *rd_buf   = m_resp_buf;
+
+    assert(expected <= RESP_BUF_SIZE);
+    int rd_len = port_read(rd_buf, expected, timeout_ms);
     if (rd_len == expected)
     {
         tStatusBlock *sts = (tStatusBlock *)&rd_buf[length4];
         if (sts->seq_num != seq_num)
         {
+            m_stats.seq_errors++;
             fprintf(stderr, "ERROR: Sequence number: %04x != %04x\n", sts->seq_num, seq_num);
-            ok = false;
+            return NULL;
         }   
     }
     else
     {
         fprintf(stderr, "ERROR: Failed to read data (got %d, expected %d)\n", rd_len, expected);
-        ok = false;
-    }
-
-    if (!ok)
-    {
-        delete [] rd_buf;
         return NULL;
     }
-    else
-        return rd_buf;
+
+    return rd_buf;
 }
 //-------------------------------------------------------------
 // send_drain: Send drain request
 //-------------------------------------------------------------
 bool ftdi_axi_driver::send_drain(int timeout_ms)
 {
+    flush_combined(timeout_ms);
+
     uint8_t wr_buf[256];
     for (int i=0;i<sizeof(wr_buf);i++)
         wr_buf[i] = CMD_ID_DRAIN;
-    m_port->write(wr_buf, sizeof(wr_buf), timeout_ms);
+    port_write(wr_buf, sizeof(wr_buf), timeout_ms);
 
     return true;
 }
@@ -153,9 +213,9 @@ bool ftdi_axi_driver::send_drain(int timeout_ms)
 bool ftdi_axi_driver::send_echo(uint8_t *data, int length, int timeout_ms)
 {
     int  length4 = ((length + 3)/4) * 4;
-    bool ok      = true;
+    bool ok      = flush_combined(timeout_ms);
 
-    if (!send_command(CMD_ID_ECHO, 0, data, length, timeout_ms))
+    if (!ok || !send_command(CMD_ID_ECHO, 0, data, length, timeout_ms))
     {
         fprintf(stderr, "ERROR: Failed to send echo data\n");
         ok = false;
@@ -171,7 +231,6 @@ bool ftdi_axi_driver::send_echo(uint8_t *data, int length, int timeout_ms)
                     fprintf(stderr, "ERROR: ECHO mismatch %d: %02x != %02x\n", i, rd_buf[i], data[i]);
                     ok = false;
                 }
-            delete [] rd_buf;
         }
         else
             ok = false;
@@ -184,15 +243,15 @@ bool ftdi_axi_driver::send_echo(uint8_t *data, int length, int timeout_ms)
 //-------------------------------------------------------------
 bool ftdi_axi_driver::gpio_write(uint32_t value, int timeout_ms)
 {
-    bool ok = send_command(CMD_ID_GPIO_WR, 0, (uint8_t *)&value, 4, timeout_ms);
+    uint64_t t0 = stats_now_ns();
+    bool ok = flush_combined(timeout_ms) &&
+              send_command(CMD_ID_GPIO_WR, 0, (uint8_t *)&value, 4, timeout_ms);
     if (ok)
     {
-        uint8_t* rd_buf = recv_data(m_seq_num - 1, 0, timeout_ms);
-        if (rd_buf)
-            delete [] rd_buf;
-        else
+        if (!recv_data(m_seq_num - 1, 0, timeout_ms))
             ok = false;
     }
+    stat_op(AXI_STAT_GPIO, t0, ok);
     return ok;
 }
 //-------------------------------------------------------------
@@ -200,18 +259,60 @@ bool ftdi_axi_driver::gpio_write(uint32_t value, int timeout_ms)
 //-------------------------------------------------------------
 bool ftdi_axi_driver::gpio_read(uint32_t &value, int timeout_ms)
 {
-    bool ok = send_command(CMD_ID_GPIO_RD, 0, NULL, 4, timeout_ms);
+    uint64_t t0 = stats_now_ns();
+    bool ok = flush_combined(timeout_ms) &&
+              send_command(CMD_ID_GPIO_RD, 0, NULL, 4, timeout_ms);
     if (ok)
     {
         uint8_t* rd_buf   = recv_data(m_seq_num - 1, 4, timeout_ms);
         if (rd_buf)
         {
             value = *((uint32_t*)rd_buf);
-            delete [] rd_buf;
         }
         else
             ok = false;
     }
+    stat_op(AXI_STAT_GPIO, t0, ok);
+    return ok;
+}
+//-------------------------------------------------------------
+// transact: Send a batch of operations, receive all responses
+//-------------------------------------------------------------
+bool ftdi_axi_driver::transact(ftdi_axi_batch &batch, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+
+    // Staged writes go first (they share the OUT buffer)
+    bool ok = send_write_queue(timeout_ms);
+    if (ok)
+    {
+        for (int i=0;i<batch.count();i++)
+        {
+            tAxiOp &op = batch.op(i);
+            m_stats.commands += op.commands;
+
+            // Batched writes are not applied to the cache
+            if (op.cmd_id >= CMD_ID_WRITE8_NP && op.cmd_id <= CMD_ID_WRITE)
+                cache_write(op.addr & ~3, NULL, op.length);
+        }
+
+        int wr_len = batch.frame(m_write_buf, m_seq_num);
+        int sent   = port_write(m_write_buf, wr_len, timeout_ms);
+        if (sent != wr_len)
+        {
+            fprintf(stderr, "ERROR: Failed to send batch\n");
+            ok = false;
+        }
+    }
+
+    // Nothing comes back for an all posted batch
+    int expected = batch.resp_length();
+    if (ok && expected && !recv_block(m_read_bufs[0], expected, timeout_ms))
+        ok = false;
+    if (ok && !batch.parse(m_read_bufs[0], expected))
+        ok = false;
+
+    stat_op(AXI_STAT_BATCH, t0, ok);
     return ok;
 }
 //-------------------------------------------------------------
@@ -219,16 +320,19 @@ bool ftdi_axi_driver::gpio_read(uint32_t &value, int timeout_ms)
 //-------------------------------------------------------------
 bool ftdi_axi_driver::write8(uint32_t addr, uint8_t data, int timeout_ms, bool posted)
 {
+    uint64_t t0 = stats_now_ns();
     uint32_t wr_data = (uint32_t)data << (8 * (addr & 3));
-    bool ok = send_command(posted ? CMD_ID_WRITE8 : CMD_ID_WRITE8_NP, addr, (uint8_t *)&wr_data, 4, timeout_ms);
+    cache_write(addr, &data, 1);
+    bool ok = flush_combined(timeout_ms) &&
+              send_command(posted ? CMD_ID_WRITE8 : CMD_ID_WRITE8_NP, addr, (uint8_t *)&wr_data, 4, timeout_ms);
     if (ok && !posted)
     {
-        uint8_t* rd_buf = recv_data(m_seq_num - 1, 0, timeout_ms);
-        if (rd_buf)
-            delete [] rd_buf;
-        else
+        if (!recv_data(m_seq_num - 1, 0, timeout_ms))
             ok = false;
     }
+    if (!ok)
+        cache_write(addr, NULL, 1);
+    stat_op(AXI_STAT_WRITE32, t0, ok);
     return ok;
 }
 //-------------------------------------------------------------
@@ -236,15 +340,25 @@ bool ftdi_axi_driver::write8(uint32_t addr, uint8_t data, int timeout_ms, bool p
 //-------------------------------------------------------------
 bool ftdi_axi_driver::write32(uint32_t addr, uint32_t data, int timeout_ms, bool posted)
 {
-    bool ok = send_command(posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, (uint8_t *)&data, 4, timeout_ms);
+    uint64_t t0 = stats_now_ns();
+    cache_write(addr & ~3, (uint8_t *)&data, 4);
+    if (posted && m_wc_max)
+    {
+        bool ok = combine_write32(addr, data, timeout_ms);
+        stat_op(AXI_STAT_WRITE32, t0, ok);
+        return ok;
+    }
+
+    bool ok = flush_combined(timeout_ms) &&
+              send_command(posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr, (uint8_t *)&data, 4, timeout_ms);
     if (ok && !posted)
     {
-        uint8_t* rd_buf = recv_data(m_seq_num - 1, 0, timeout_ms);
-        if (rd_buf)
-            delete [] rd_buf;
-        else
+        if (!recv_data(m_seq_num - 1, 0, timeout_ms))
             ok = false;
     }
+    if (!ok)
+        cache_write(addr & ~3, NULL, 4);
+    stat_op(AXI_STAT_WRITE32, t0, ok);
     return ok;
 }
 //-------------------------------------------------------------
@@ -252,43 +366,146 @@ bool ftdi_axi_driver::write32(uint32_t addr, uint32_t data, int timeout_ms, bool
 //-------------------------------------------------------------
 bool ftdi_axi_driver::read32(uint32_t addr, uint32_t &data, int timeout_ms)
 {
-    bool ok = send_command(CMD_ID_READ, addr, NULL, 4, timeout_ms);
+    uint64_t t0 = stats_now_ns();
+    if (cacheable(addr & ~3, 4))
+    {
+        bool ok = cached_read(addr & ~3, (uint8_t *)&data, 4, timeout_ms);
+        stat_op(AXI_STAT_READ32, t0, ok);
+        return ok;
+    }
+
+    bool ok = flush_combined(timeout_ms) &&
+              send_command(CMD_ID_READ, addr, NULL, 4, timeout_ms);
     if (ok)
     {
         uint8_t* rd_buf   = recv_data(m_seq_num - 1, 4, timeout_ms);
         if (rd_buf)
         {
             data = *((uint32_t*)rd_buf);
-            delete [] rd_buf;
         }
         else
             ok = false;
     }
+    stat_op(AXI_STAT_READ32, t0, ok);
     return ok;
 }
 //-------------------------------------------------------------
-// write: Write a block of data
+// set_write_window: Max number of non-posted write batches which
+// can be in-flight before write() blocks on the oldest ack.
 //-------------------------------------------------------------
-bool ftdi_axi_driver::write(uint32_t addr, uint8_t *data, int length, int timeout_ms, bool posted)
+void ftdi_axi_driver::set_write_window(int batches)
 {
-    // Unaligned head
-    while ((addr & 3) && length)
-    {
-        if (!write8(addr, *data, timeout_ms))
+    if (batches < 1)
+        batches = 1;
+    else if (batches > MAX_WR_WINDOW)
+        batches = MAX_WR_WINDOW;
+
+    m_wr_window = batches;
+}
+//-------------------------------------------------------------
+// set_fence_interval: Bytes of a posted block write between
+// non-posted fences (WR_FENCE_BATCH: every batch, WR_FENCE_END:
+// only the end of the write). Fences land on batch boundaries.
+//-------------------------------------------------------------
+void ftdi_axi_driver::set_fence_interval(int bytes)
+{
+    if (bytes < 0)
+        bytes = WR_FENCE_END;
+
+    m_wr_fence = bytes;
+}
+//-------------------------------------------------------------
+// push_write_ack: Record an outstanding batch ack (by seq_num),
+// retiring the oldest one if the window is full.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::push_write_ack(uint16_t seq_num, int timeout_ms)
+{
+    int idx = (m_wr_pending_head + m_wr_pending_count) % MAX_WR_WINDOW;
+    m_wr_pending[idx] = seq_num;
+    m_wr_pending_count++;
+
+    while (m_wr_pending_count >= m_wr_window)
+        if (!pop_write_ack(timeout_ms))
             return false;
-        addr++;
-        length--;
-        data++;
+
+    return true;
+}
+//-------------------------------------------------------------
+// pop_write_ack: Wait for the oldest outstanding batch ack
+//-------------------------------------------------------------
+bool ftdi_axi_driver::pop_write_ack(int timeout_ms)
+{
+    uint16_t seq_num = m_wr_pending[m_wr_pending_head];
+    m_wr_pending_head = (m_wr_pending_head + 1) % MAX_WR_WINDOW;
+    m_wr_pending_count--;
+
+    uint64_t t0 = stats_now_ns();
+    bool ok = recv_data(seq_num, 0, timeout_ms) != NULL;
+    m_stats.ack_wait_ns += stats_now_ns() - t0;
+
+    if (!ok)
+    {
+        // Response stream is out of step - abandon the rest
+        m_wr_pending_count = 0;
+        return false;
     }
 
+    return true;
+}
+//-------------------------------------------------------------
+// flush_write_acks: Wait for all outstanding batch acks
+//-------------------------------------------------------------
+bool ftdi_axi_driver::flush_write_acks(int timeout_ms)
+{
+    while (m_wr_pending_count)
+        if (!pop_write_ack(timeout_ms))
+            return false;
+
+    return true;
+}
+//-------------------------------------------------------------
+// write: Write a block of data
+//-------------------------------------------------------------
+bool ftdi_axi_driver::write(uint32_t addr, uint8_t *data, int length, int timeout_ms, bool posted)
+{
+    uint64_t t0 = stats_now_ns();
+    cache_write(addr, data, length);
+    bool ok = flush_combined(timeout_ms) && write_block(addr, data, length, timeout_ms, posted);
+    if (!ok)
+        cache_write(addr, NULL, length);
+    stat_op(AXI_STAT_WRITE, t0, ok);
+    return ok;
+}
+bool ftdi_axi_driver::write_block(uint32_t addr, uint8_t *data, int length, int timeout_ms, bool posted)
+{
     uint8_t *wr_buf = m_write_buf;
-    int chunks = 0;
+    int chunks   = 0;
+    int unfenced = 0;
 
-    while (length >= 4)
+    // Unaligned head / tail bytes are framed as posted 8/16-bit
+    // writes in the same batch as the word aligned body.
+    while (length)
     {
-        int  size = (length < MAX_CHUNK_SIZE) ? (length & ~3) : MAX_CHUNK_SIZE;
-        bool last = ((length - size) < MAX_CHUNK_SIZE) || (chunks >= (MAX_WR_CHUNKS-1));
-        wr_buf += fill_command(wr_buf, last ? CMD_ID_WRITE_NP : CMD_ID_WRITE, addr, data, size);
+        uint8_t  cmd_id;
+        uint32_t lane;
+        int      size = next_write(addr, data, length, cmd_id, lane);
+        bool     last = (size == length) || (chunks >= (m_batch_chunks-1));
+
+        // Non-posted batches (and the end of the write) finish with a
+        // write with response. Posted batches in between are only
+        // fenced once the interval is reached - the OUT pipe flow
+        // control keeps the target FIFO from overrunning, and the ack
+        // window bounds the responses outstanding.
+        unfenced += size;
+        bool fence = last && ((size == length) || !posted || m_wr_fence == WR_FENCE_BATCH ||
+                              (m_wr_fence > 0 && unfenced >= m_wr_fence));
+        if (fence)
+            cmd_id = CMD_ID_NP(cmd_id);
+
+        if (size & 3)
+            wr_buf += fill_command(wr_buf, cmd_id, addr, (uint8_t *)&lane, 4);
+        else
+            wr_buf += fill_command(wr_buf, cmd_id, addr, data, size);
         addr   += size;
         data   += size;
         length -= size;
@@ -296,114 +513,1015 @@ bool ftdi_axi_driver::write(uint32_t addr, uint8_t *data, int length, int timeou
 
         if (last)
         {
-            int sent = m_port->write(m_write_buf, wr_buf - m_write_buf, timeout_ms);
-
-            uint8_t* rd_buf = recv_data(m_seq_num - 1, 0, timeout_ms);
-            if (rd_buf)
-                delete [] rd_buf;
-            else
+            int wr_len = wr_buf - m_write_buf;
+            int sent   = port_write(m_write_buf, wr_len, timeout_ms);
+            if (sent != wr_len)
+            {
+                fprintf(stderr, "ERROR: Failed to send write data\n");
+                m_wr_pending_count = 0;
                 return false;
+            }
+
+            // Track the batch acknowledgement, only blocking once the
+            // window of outstanding batches is full.
+            if (fence)
+            {
+                if (!push_write_ack(m_seq_num - 1, timeout_ms))
+                    return false;
+                unfenced = 0;
+            }
 
             chunks = 0;
             wr_buf = m_write_buf;
         }
     }
 
-    // Unaligned tail
-    while (length)
+    // Collect outstanding acknowledgements
+    return flush_write_acks(timeout_ms);
+}
+//-------------------------------------------------------------
+// next_write: Pick the widest write command for the start of a
+// range, returning the bytes it covers. Byte / halfword writes
+// carry their data in its byte lanes of one payload word (lane).
+//-------------------------------------------------------------
+int ftdi_axi_driver::next_write(uint32_t addr, uint8_t *data, int length, uint8_t &cmd_id, uint32_t &lane)
+{
+    int size;
+
+    if ((addr & 1) || length == 1)
     {
-        if (!write8(addr, *data, timeout_ms))
-            return false;
-        addr++;
-        length--;
-        data++;
+        cmd_id = CMD_ID_WRITE8;
+        size   = 1;
+    }
+    else if ((addr & 2) || length < 4)
+    {
+        cmd_id = CMD_ID_WRITE16;
+        size   = 2;
+    }
+    else
+    {
+        cmd_id = CMD_ID_WRITE;
+        return (length < m_chunk_size) ? (length & ~3) : m_chunk_size;
+    }
+
+    lane = 0;
+    memcpy((uint8_t *)&lane + (addr & 3), data, size);
+    return size;
+}
+//-------------------------------------------------------------
+// set_chunk_size: Bytes per block read/write command
+//-------------------------------------------------------------
+void ftdi_axi_driver::set_chunk_size(int bytes)
+{
+    bytes &= ~3;
+    if (bytes < 4)
+        bytes = 4;
+    else if (bytes > MAX_CHUNK_SIZE)
+        bytes = MAX_CHUNK_SIZE;
+
+    m_chunk_size = bytes;
+}
+//-------------------------------------------------------------
+// set_batch_chunks: Commands per block read/write batch
+//-------------------------------------------------------------
+void ftdi_axi_driver::set_batch_chunks(int chunks)
+{
+    if (chunks < 1)
+        chunks = 1;
+    else if (chunks > MAX_BATCH_CHUNKS)
+        chunks = MAX_BATCH_CHUNKS;
+
+    m_batch_chunks = chunks;
+}
+//-------------------------------------------------------------
+// set_read_depth: Number of block read batches kept in flight
+//-------------------------------------------------------------
+void ftdi_axi_driver::set_read_depth(int batches)
+{
+    if (batches < 1)
+        batches = 1;
+    else if (batches > MAX_RD_DEPTH)
+        batches = MAX_RD_DEPTH;
+
+    m_rd_depth = batches;
+}
+//-------------------------------------------------------------
+// issue_read_batch: Frame and send a batch of reads. An unaligned
+// range is widened to word alignment and trimmed when de-framed.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::issue_read_batch(uint32_t &addr, uint8_t *&data, int &length, tReadBatch &batch, int timeout_ms)
+{
+    uint8_t *wr_buf = m_write_buf;
+
+    batch.data       = data;
+    batch.chunks     = 0;
+    batch.expected   = 0;
+    batch.seq_num    = m_seq_num;
+    batch.chunk_size = m_chunk_size;
+    batch.skip       = addr & 3;
+    batch.length     = 0;
+
+    while (length > 0 && batch.chunks < m_batch_chunks)
+    {
+        int skip = addr & 3;
+        int size = (skip + length + 3) & ~3;
+        if (size > m_chunk_size)
+            size = m_chunk_size;
+
+        int host = ((size - skip) < length) ? (size - skip) : length;
+        wr_buf += fill_command(wr_buf, CMD_ID_READ, addr & ~3, NULL, size);
+        addr   += host;
+        data   += host;
+        length -= host;
+        batch.chunks   += 1;
+        batch.expected += size + sizeof(tStatusBlock);
+        batch.length   += host;
+    }
+
+    int wr_len = wr_buf - m_write_buf;
+    int sent   = port_write(m_write_buf, wr_len, timeout_ms);
+    if (sent != wr_len)
+    {
+        fprintf(stderr, "ERROR: Failed to send read commands\n");
+        return false;
     }
 
     return true;
 }
 //-------------------------------------------------------------
-// read: Read a block of data
+// recv_block: Receive a batch worth of response data
 //-------------------------------------------------------------
-bool ftdi_axi_driver::read(uint32_t addr, uint8_t *data, int length, int timeout_ms)
+bool ftdi_axi_driver::recv_block(uint8_t *rd_buf, int expected, int timeout_ms)
 {
-    // Unaligned head
-    if (addr & 3)
+    int rd_len = port_read(rd_buf, expected, timeout_ms);
+    if (rd_len < 0)
+        return false;
+
+    // Wait for remaining data
+    if (rd_len != expected)
     {
-        uint32_t dw;
-        if (!read32(addr, dw, timeout_ms))
-            return false;
+        // Stream mode only takes whole stream size requests - read
+        // the rest of the transfer with it cleared
+        if (m_streaming)
+        {
+            m_port->set_read_stream(0);
+            m_streaming = false;
+        }
 
-        for (int b=(addr & 3);b<4;b++)
+        int remain = expected - rd_len;
+        m_stats.read_retries++;
+        int retry  = port_read(&rd_buf[rd_len], remain, timeout_ms);
+        if (retry != remain)
         {
-            *data++ = (dw >> (8*b));
-            addr++;
-            length--;
+            fprintf(stderr, "ERROR: Data underflow\n");
+            return false;
         }
     }
 
-    uint8_t *wr_buf = m_write_buf;
-    int chunks = 0;
-    int expected = 0;
+    return true;
+}
+//-------------------------------------------------------------
+// complete_read_batch: Receive a batch of read data and de-frame
+//-------------------------------------------------------------
+bool ftdi_axi_driver::complete_read_batch(tReadBatch &batch, uint8_t *rd_buf, int timeout_ms)
+{
+    int expected = batch.expected;
+    if (!recv_block(rd_buf, expected, timeout_ms))
+        return false;
 
-    while (length >= 4)
+    uint8_t *p      = rd_buf;
+    uint8_t *data   = batch.data;
+    int      skip   = batch.skip;
+    int      length = batch.length;
+    int data_ready = expected - (batch.chunks * sizeof(tStatusBlock));
+    for (int i=0;i<batch.chunks;i++)
     {
-        int  size = (length < MAX_CHUNK_SIZE) ? (length & ~3) : MAX_CHUNK_SIZE;
-        bool last = ((length - size) < MAX_CHUNK_SIZE) || (chunks >= (MAX_RD_CHUNKS-1));
-        wr_buf += fill_command(wr_buf, CMD_ID_READ, addr, NULL, size);
-        addr   += size;
-        length -= size;
-        chunks += 1;
-        expected += size + 4;
+        int remain = (data_ready < batch.chunk_size) ? data_ready : batch.chunk_size;
+        int copy   = ((remain - skip) < length) ? (remain - skip) : length;
+        memcpy(data, p + skip, copy);
+        data   += copy;
+        length -= copy;
+        skip    = 0;
+        p += remain;
+        data_ready -= remain;
 
-        if (last)
+        // Check and skip status block
+        tStatusBlock *sts = (tStatusBlock *)p;
+        uint16_t seq_num  = batch.seq_num + i;
+        if (sts->seq_num != seq_num)
         {
-            int sent   = m_port->write(m_write_buf, wr_buf - m_write_buf, timeout_ms);
-            int rd_len = m_port->read(m_read_buf, expected, timeout_ms);
-            if (rd_len < 0)
-                return false;
-
-            // Wait for remaining data
-            if (rd_len != expected)
-            {
-                int remain = expected - rd_len;
-                int retry  = m_port->read(&m_read_buf[rd_len], remain, timeout_ms);
-                if (retry != remain)
-                {
-                    fprintf(stderr, "ERROR: Data underflow\n");
-                    return false;
-                }
-            }
+            m_stats.seq_errors++;
+            fprintf(stderr, "ERROR: Sequence number: %04x != %04x\n", sts->seq_num, seq_num);
+            return false;
+        }
+        p += sizeof(tStatusBlock);
+    }
 
-            uint8_t *p = m_read_buf;
-            int data_ready = expected - (chunks * 4);
-            for (int i=0;i<chunks;i++)
-            {
-                int remain = (data_ready < MAX_CHUNK_SIZE) ? data_ready : MAX_CHUNK_SIZE;
-                memcpy(data, p, remain);
-                data += remain;
-                p += remain;
-                data_ready -= remain;
-
-                // Skip status block
-                p += 4;
-            }
+    return true;
+}
+//-------------------------------------------------------------
+// read_pipelined: Read a block as a pipeline of batches
+//-------------------------------------------------------------
+bool ftdi_axi_driver::read_pipelined(uint32_t &addr, uint8_t *&data, int &length, int timeout_ms)
+{
+    // Keep up to m_rd_depth batches of read commands in flight so the
+    // target always has the next batch queued while the host drains
+    // and de-frames the previous one.
+    tReadBatch batches[MAX_RD_DEPTH];
+    int issued    = 0;
+    int completed = 0;
 
-            chunks = 0;
-            expected = 0;
-            wr_buf = m_write_buf;
+    while (length > 0 || completed < issued)
+    {
+        if (length > 0 && (issued - completed) < m_rd_depth)
+        {
+            if (!issue_read_batch(addr, data, length, batches[issued % MAX_RD_DEPTH], timeout_ms))
+                return false;
+            issued++;
+        }
+        else
+        {
+            int slot = completed % MAX_RD_DEPTH;
+            if (!complete_read_batch(batches[slot], m_read_bufs[slot], timeout_ms))
+                return false;
+            completed++;
         }
     }
 
-    // Unaligned tail
-    if (length)
+    return true;
+}
+//-------------------------------------------------------------
+// read: Read a block of data
+//-------------------------------------------------------------
+bool ftdi_axi_driver::read(uint32_t addr, uint8_t *data, int length, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+    bool ok;
+    if (length > 0 && cacheable(addr, length))
+        ok = cached_read(addr, data, length, timeout_ms);
+    else
+        ok = flush_combined(timeout_ms) && read_block(addr, data, length, timeout_ms);
+    stat_op(AXI_STAT_READ, t0, ok);
+    return ok;
+}
+bool ftdi_axi_driver::read_block(uint32_t addr, uint8_t *data, int length, int timeout_ms)
+{
+    // Whole batches all produce the same IN size - let the transport
+    // stream them as fixed size transfers if it can. An unaligned
+    // head only shortens the host side of the first batch.
+    int batch_bytes = m_chunk_size * m_batch_chunks;
+    int skip        = addr & 3;
+    if (m_stream_reads && (length + skip) >= (2 * batch_bytes) &&
+        m_port->set_read_stream(batch_bytes + (m_batch_chunks * sizeof(tStatusBlock))))
     {
-        uint32_t dw;
-        if (!read32(addr, dw, timeout_ms))
+        int stream_len = (((length + skip) / batch_bytes) * batch_bytes) - skip;
+        int remain     = length - stream_len;
+        m_streaming    = true;
+        bool ok = read_pipelined(addr, data, stream_len, timeout_ms);
+        if (m_streaming)
+            m_port->set_read_stream(0);
+        m_streaming    = false;
+        if (!ok)
             return false;
-
-        for (int b=0;b<length;b++)
-            *data++ = (dw >> (8*b));
+        length = remain;
     }
 
-    return true;
+    return read_pipelined(addr, data, length, timeout_ms);
+}
+//-------------------------------------------------------------
+// queue_write: Append a write command to the batch being built in
+// m_write_buf, sending the batch (without waiting) when full.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::queue_write(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, int timeout_ms)
+{
+    int need = sizeof(tCommandBlock) + (((length + 3)/4) * 4);
+    if (((m_wr_pos - m_write_buf) + need) > WRITE_BUF_SIZE)
+    {
+        if (!send_write_queue(timeout_ms))
+            return false;
+    }
+
+    m_wc_cmd  = NULL;
+    m_wr_pos += fill_command(m_wr_pos, cmd_id, addr, data, length);
+    return true;
+}
+//-------------------------------------------------------------
+// queue_write_bytes: Queue posted writes for an arbitrary range
+//-------------------------------------------------------------
+bool ftdi_axi_driver::queue_write_bytes(uint32_t addr, uint8_t *data, int length, int timeout_ms)
+{
+    while (length)
+    {
+        uint8_t  cmd_id;
+        uint32_t lane;
+        int      size = next_write(addr, data, length, cmd_id, lane);
+
+        bool ok;
+        if (size & 3)
+            ok = queue_write(cmd_id, addr, (uint8_t *)&lane, 4, timeout_ms);
+        else
+            ok = queue_write(cmd_id, addr, data, size, timeout_ms);
+        if (!ok)
+            return false;
+
+        addr   += size;
+        data   += size;
+        length -= size;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// queue_fence: Terminate the queued writes with a fence and send.
+// A zero length ECHO is answered only once the target has finished
+// every command before it (including their AXI write responses).
+//-------------------------------------------------------------
+bool ftdi_axi_driver::queue_fence(int timeout_ms)
+{
+    uint16_t seq_num = m_seq_num;
+    if (!queue_write(CMD_ID_ECHO, 0, NULL, 0, timeout_ms))
+        return false;
+    if (!send_write_queue(timeout_ms))
+        return false;
+
+    return push_write_ack(seq_num, timeout_ms);
+}
+//-------------------------------------------------------------
+// send_write_queue: Send the queued write batch
+//-------------------------------------------------------------
+bool ftdi_axi_driver::send_write_queue(int timeout_ms)
+{
+    int wr_len = m_wr_pos - m_write_buf;
+    m_wr_pos   = m_write_buf;
+
+    m_wc_pending = false;
+    m_wc_bytes   = 0;
+    m_wc_cmd     = NULL;
+
+    if (wr_len == 0)
+        return true;
+
+    int sent = port_write(m_write_buf, wr_len, timeout_ms);
+    if (sent != wr_len)
+    {
+        fprintf(stderr, "ERROR: Failed to send write data\n");
+        return false;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// set_write_combining: Max posted write32 bytes held for combining
+// (0: disabled)
+//-------------------------------------------------------------
+void ftdi_axi_driver::set_write_combining(int max_bytes)
+{
+    if (max_bytes < 0)
+        max_bytes = 0;
+    else if (max_bytes > (WRITE_BUF_SIZE / 2))
+        max_bytes = WRITE_BUF_SIZE / 2;
+
+    m_wc_max = max_bytes & ~3;
+}
+//-------------------------------------------------------------
+// combine_write32: Queue a posted write32, extending the open
+// burst if it follows on from it.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::combine_write32(uint32_t addr, uint32_t data, int timeout_ms)
+{
+    tCommandBlock *cmd = m_wc_cmd;
+    if (cmd && !(addr & 3) && addr == (cmd->addr + (cmd->length * 4)) &&
+        ((cmd->length + 1) * 4) <= m_chunk_size &&
+        ((m_wr_pos - m_write_buf) + 4) <= WRITE_BUF_SIZE)
+    {
+        memcpy(m_wr_pos, &data, 4);
+        m_wr_pos    += 4;
+        cmd->length += 1;
+    }
+    else
+    {
+        if (!queue_write(CMD_ID_WRITE, addr & ~3, (uint8_t *)&data, 4, timeout_ms))
+        {
+            // This write and those held with it never reached the target
+            cache_invalidate();
+            return false;
+        }
+        m_wc_cmd = (tCommandBlock *)(m_wr_pos - sizeof(tCommandBlock) - 4);
+        m_stats.wc_bursts++;
+    }
+
+    if (!m_wc_pending)
+    {
+        m_wc_pending  = true;
+        m_wc_start_ns = stats_now_ns();
+    }
+    m_wc_bytes += 4;
+    m_stats.wc_writes++;
+
+    // Size limit / age of the oldest held write
+    if (m_wc_bytes >= m_wc_max ||
+        (stats_now_ns() - m_wc_start_ns) >= ((uint64_t)m_wc_timeout_us * 1000))
+    {
+        if (!send_write_queue(timeout_ms))
+        {
+            cache_invalidate();
+            return false;
+        }
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// flush_combined: Send anything held in the OUT buffer (combined
+// writes, write_reserve() staging) ahead of another operation,
+// which keeps ordering and frees the buffer for its own framing.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::flush_combined(int timeout_ms)
+{
+    if (m_wr_pos == m_write_buf)
+        return true;
+
+    // Combined writes were applied to the cache when queued
+    bool held = m_wc_pending;
+    if (!send_write_queue(timeout_ms))
+    {
+        if (held)
+            cache_invalidate();
+        return false;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// flush: Send held posted writes
+//-------------------------------------------------------------
+bool ftdi_axi_driver::flush(int timeout_ms)
+{
+    return flush_combined(timeout_ms);
+}
+//-------------------------------------------------------------
+// poll: Send held posted writes if the oldest has timed out
+//-------------------------------------------------------------
+bool ftdi_axi_driver::poll(int timeout_ms)
+{
+    if (!m_wc_pending || (stats_now_ns() - m_wc_start_ns) < ((uint64_t)m_wc_timeout_us * 1000))
+        return true;
+
+    return flush_combined(timeout_ms);
+}
+//-------------------------------------------------------------
+// cached_read: Read of a cacheable region - served from the line
+// cache, or fills the lines covering it with one burst read.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::cached_read(uint32_t addr, uint8_t *data, int length, int timeout_ms)
+{
+    if (m_cache.lookup(addr, data, length))
+    {
+        m_stats.cache_hits++;
+        return true;
+    }
+    m_stats.cache_misses++;
+
+    if (!flush_combined(timeout_ms))
+        return false;
+
+    uint32_t base     = addr & ~(CACHE_LINE_SIZE - 1);
+    uint64_t end      = ((uint64_t)addr + length + CACHE_LINE_SIZE - 1) & ~(uint64_t)(CACHE_LINE_SIZE - 1);
+    int      fill_len = (int)(end - base);
+
+    // Too large to allocate - read straight through
+    if (fill_len > CACHE_FILL_MAX)
+        return read_block(addr, data, length, timeout_ms);
+
+    uint8_t *buf = m_cache.fill_buffer();
+    if (!read_block(base, buf, fill_len, timeout_ms))
+        return false;
+
+    m_cache.fill(base, buf, fill_len);
+    memcpy(data, buf + (addr - base), length);
+    return true;
+}
+//-------------------------------------------------------------
+// writev: Write a list of (address, buffer, length) spans
+//-------------------------------------------------------------
+bool ftdi_axi_driver::writev(const tAxiSpan *spans, int count, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+    for (int i=0;i<count;i++)
+        cache_write(spans[i].addr, spans[i].data, spans[i].length);
+
+    bool ok = writev_spans(spans, count, timeout_ms);
+    if (!ok)
+        for (int i=0;i<count;i++)
+            cache_write(spans[i].addr, NULL, spans[i].length);
+    stat_op(AXI_STAT_WRITE, t0, ok);
+    return ok;
+}
+bool ftdi_axi_driver::writev_spans(const tAxiSpan *spans, int count, int timeout_ms)
+{
+    for (int i=0;i<count;i++)
+    {
+        if (!queue_write_bytes(spans[i].addr, spans[i].data, spans[i].length, timeout_ms))
+        {
+            m_wr_pos = m_write_buf;
+            return false;
+        }
+    }
+
+    // Single fence for the whole list
+    if (!queue_fence(timeout_ms))
+        return false;
+
+    return flush_write_acks(timeout_ms);
+}
+//-------------------------------------------------------------
+// write_reserve: Lay out write commands for a range in the staging
+// buffer and return the payload areas for the caller to fill.
+//-------------------------------------------------------------
+int ftdi_axi_driver::write_reserve(uint32_t addr, int length, tAxiSpan *spans, int max_spans, int &num_spans, int timeout_ms)
+{
+    // Data is not known until filled in - drop any cached copy
+    cache_write(addr, NULL, length);
+
+    int reserved = 0;
+    num_spans    = 0;
+
+    while (reserved < length && num_spans < max_spans)
+    {
+        uint32_t a      = addr + reserved;
+        int      remain = length - reserved;
+        bool     bytew  = (a & 3) || (remain < 4);
+        int      size   = bytew ? 4 : ((remain < m_chunk_size) ? (remain & ~3) : m_chunk_size);
+        int      need   = sizeof(tCommandBlock) + size;
+
+        if (((m_wr_pos - m_write_buf) + need) > WRITE_BUF_SIZE)
+        {
+            // Spans returned by this call are not filled yet - stop here
+            if (num_spans)
+                break;
+
+            // Earlier reservations are complete, send them on
+            if (!send_write_queue(timeout_ms))
+                return -1;
+        }
+
+        m_wc_cmd = NULL;
+        uint8_t *payload = m_wr_pos + fill_command(m_wr_pos, bytew ? CMD_ID_WRITE8 : CMD_ID_WRITE, a, NULL, size);
+        m_wr_pos = payload + size;
+
+        tAxiSpan *span = &spans[num_spans++];
+        span->addr = a;
+        if (bytew)
+        {
+            // Byte lane within the payload word
+            memset(payload, 0, 4);
+            span->data   = payload + (a & 3);
+            span->length = 1;
+        }
+        else
+        {
+            span->data   = payload;
+            span->length = size;
+        }
+        reserved += span->length;
+    }
+
+    return reserved;
+}
+//-------------------------------------------------------------
+// write_commit: Send staged writes, optionally with a fence
+//-------------------------------------------------------------
+bool ftdi_axi_driver::write_commit(bool fence, int timeout_ms)
+{
+    if (!fence)
+        return send_write_queue(timeout_ms);
+
+    if (!queue_fence(timeout_ms))
+        return false;
+
+    return flush_write_acks(timeout_ms);
+}
+//-------------------------------------------------------------
+// issue_readv_batch: Frame and send reads for the next spans.
+// Unaligned spans are widened to word alignment and trimmed when
+// de-framed.
+//-------------------------------------------------------------
+bool ftdi_axi_driver::issue_readv_batch(const tAxiSpan *spans, int count, int &span, int &offset, tReadBatch &batch, tSgRead *desc, int timeout_ms)
+{
+    uint8_t *wr_buf = m_write_buf;
+
+    batch.data       = NULL;
+    batch.chunks     = 0;
+    batch.expected   = 0;
+    batch.seq_num    = m_seq_num;
+    batch.chunk_size = m_chunk_size;
+
+    while (span < count && batch.chunks < m_batch_chunks)
+    {
+        const tAxiSpan *s = &spans[span];
+        if (offset >= s->length)
+        {
+            span++;
+            offset = 0;
+            continue;
+        }
+
+        uint32_t addr   = s->addr + offset;
+        int      skip   = addr & 3;
+        int      remain = s->length - offset;
+        int      words  = (skip + remain + 3) / 4;
+        if (words > (m_chunk_size / 4))
+            words = m_chunk_size / 4;
+
+        int size = words * 4;
+        if ((batch.expected + size + (int)sizeof(tStatusBlock)) > READ_BUF_SIZE)
+            break;
+
+        tSgRead *d = &desc[batch.chunks];
+        d->data   = s->data + offset;
+        d->skip   = skip;
+        d->length = ((size - skip) < remain) ? (size - skip) : remain;
+        d->words  = words;
+
+        wr_buf += fill_command(wr_buf, CMD_ID_READ, addr & ~3, NULL, size);
+        offset += d->length;
+        batch.chunks   += 1;
+        batch.expected += size + sizeof(tStatusBlock);
+    }
+
+    int wr_len = wr_buf - m_write_buf;
+    int sent   = port_write(m_write_buf, wr_len, timeout_ms);
+    if (sent != wr_len)
+    {
+        fprintf(stderr, "ERROR: Failed to send read commands\n");
+        return false;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// complete_readv_batch: Receive and scatter a batch of read data
+//-------------------------------------------------------------
+bool ftdi_axi_driver::complete_readv_batch(tReadBatch &batch, tSgRead *desc, uint8_t *rd_buf, int timeout_ms)
+{
+    if (!recv_block(rd_buf, batch.expected, timeout_ms))
+        return false;
+
+    uint8_t *p = rd_buf;
+    for (int i=0;i<batch.chunks;i++)
+    {
+        memcpy(desc[i].data, p + desc[i].skip, desc[i].length);
+        p += desc[i].words * 4;
+
+        tStatusBlock *sts = (tStatusBlock *)p;
+        uint16_t seq_num  = batch.seq_num + i;
+        if (sts->seq_num != seq_num)
+        {
+            m_stats.seq_errors++;
+            fprintf(stderr, "ERROR: Sequence number: %04x != %04x\n", sts->seq_num, seq_num);
+            return false;
+        }
+        p += sizeof(tStatusBlock);
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// readv: Read a list of (address, buffer, length) spans
+//-------------------------------------------------------------
+bool ftdi_axi_driver::readv(const tAxiSpan *spans, int count, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+    bool ok = flush_combined(timeout_ms) && readv_spans(spans, count, timeout_ms);
+    stat_op(AXI_STAT_READ, t0, ok);
+    return ok;
+}
+bool ftdi_axi_driver::readv_spans(const tAxiSpan *spans, int count, int timeout_ms)
+{
+    tReadBatch batches[MAX_RD_DEPTH];
+    int issued    = 0;
+    int completed = 0;
+    int span      = 0;
+    int offset    = 0;
+
+    // Skip empty trailing spans so no empty batch is issued
+    while (count > 0 && spans[count-1].length <= 0)
+        count--;
+
+    while (span < count || completed < issued)
+    {
+        if (span < count && (issued - completed) < m_rd_depth)
+        {
+            int slot = issued % MAX_RD_DEPTH;
+            if (!issue_readv_batch(spans, count, span, offset, batches[slot], m_sg_reads[slot], timeout_ms))
+                return false;
+            issued++;
+
+            // Advance past a completed final span
+            if (span < count && offset >= spans[span].length)
+            {
+                span++;
+                offset = 0;
+                while (span < count && spans[span].length <= 0)
+                    span++;
+            }
+        }
+        else
+        {
+            int slot = completed % MAX_RD_DEPTH;
+            if (!complete_readv_batch(batches[slot], m_sg_reads[slot], m_read_bufs[slot], timeout_ms))
+                return false;
+            completed++;
+        }
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// read_view_submit: Claim a receive buffer and issue a batch of
+// reads for (a prefix of) the range.
+//-------------------------------------------------------------
+int ftdi_axi_driver::read_view_submit(uint32_t addr, int length, tAxiReadView &view, int timeout_ms)
+{
+    if (!flush_combined(timeout_ms))
+        return -1;
+
+    int buffer = -1;
+    for (int i=0;i<MAX_READ_VIEWS && buffer < 0;i++)
+        if (!m_view_held[i])
+            buffer = i;
+
+    view.count  = 0;
+    view.length = 0;
+    view.buffer = -1;
+
+    if (buffer < 0)
+    {
+        fprintf(stderr, "ERROR: No free read view buffers\n");
+        return -1;
+    }
+
+    uint8_t *rd_buf = m_view_bufs[buffer];
+    uint8_t *wr_buf = m_write_buf;
+
+    view.expected = 0;
+    view.seq_num  = m_seq_num;
+
+    while (view.length < length && view.count < m_batch_chunks)
+    {
+        uint32_t a      = addr + view.length;
+        int      skip   = a & 3;
+        int      remain = length - view.length;
+        int      words  = (skip + remain + 3) / 4;
+        if (words > (m_chunk_size / 4))
+            words = m_chunk_size / 4;
+
+        int size = words * 4;
+        int take = ((size - skip) < remain) ? (size - skip) : remain;
+
+        tAxiSpan *span = &view.spans[view.count];
+        span->addr   = a;
+        span->data   = rd_buf + view.expected + skip;
+        span->length = take;
+        view.status[view.count]     = 0;
+        view.sts_offset[view.count] = view.expected + size;
+
+        wr_buf += fill_command(wr_buf, CMD_ID_READ, a & ~3, NULL, size);
+        view.expected += size + sizeof(tStatusBlock);
+        view.length   += take;
+        view.count    += 1;
+    }
+
+    int wr_len = wr_buf - m_write_buf;
+    int sent   = port_write(m_write_buf, wr_len, timeout_ms);
+    if (sent != wr_len)
+    {
+        fprintf(stderr, "ERROR: Failed to send read commands\n");
+        view.count  = 0;
+        view.length = 0;
+        return -1;
+    }
+
+    m_view_held[buffer] = true;
+    view.buffer = buffer;
+    view.ticket = m_view_submitted++;
+    return view.length;
+}
+//-------------------------------------------------------------
+// read_view_wait: Receive a submitted view's data in place
+//-------------------------------------------------------------
+bool ftdi_axi_driver::read_view_wait(tAxiReadView &view, int timeout_ms)
+{
+    if (view.buffer < 0 || view.ticket != m_view_completed)
+    {
+        fprintf(stderr, "ERROR: Read view waited out of order\n");
+        return false;
+    }
+    m_view_completed++;
+
+    uint8_t *rd_buf = m_view_bufs[view.buffer];
+    if (!recv_block(rd_buf, view.expected, timeout_ms))
+        return false;
+
+    for (int i=0;i<view.count;i++)
+    {
+        tStatusBlock *sts = (tStatusBlock *)&rd_buf[view.sts_offset[i]];
+        uint16_t seq_num  = view.seq_num + i;
+        if (sts->seq_num != seq_num)
+        {
+            m_stats.seq_errors++;
+            fprintf(stderr, "ERROR: Sequence number: %04x != %04x\n", sts->seq_num, seq_num);
+            return false;
+        }
+        view.status[i] = sts->status;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// read_view_release: Return a view's receive buffer for reuse
+//-------------------------------------------------------------
+void ftdi_axi_driver::read_view_release(tAxiReadView &view)
+{
+    if (view.buffer >= 0)
+        m_view_held[view.buffer] = false;
+
+    view.buffer = -1;
+    view.count  = 0;
+    view.length = 0;
+}
+//-------------------------------------------------------------
+// autotune: Sweep block framing parameters against the target
+//-------------------------------------------------------------
+static double autotune_time_ms(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (t.tv_sec * 1000.0) + (t.tv_usec / 1000.0);
+}
+bool ftdi_axi_driver::autotune(uint32_t addr, int size, int timeout_ms, bool verbose)
+{
+    static const int chunk_sizes[]  = { 256, 512, 768, MAX_CHUNK_SIZE };
+    static const int batch_chunks[] = { 16, 32, 64, MAX_BATCH_CHUNKS };
+    const int num_chunk_sizes  = sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+    const int num_batch_chunks = sizeof(batch_chunks) / sizeof(batch_chunks[0]);
+
+    uint8_t *buf = (uint8_t *)malloc(size);
+    if (!buf)
+        return false;
+    for (int i=0;i<size;i++)
+        buf[i] = rand();
+
+    int    best_chunk_size   = m_chunk_size;
+    int    best_batch_chunks = m_batch_chunks;
+    double best_time         = 0;
+    bool   ok                = true;
+
+    if (verbose)
+        printf("Chunk  Batch    Write MB/s   Read MB/s\n");
+
+    for (int c=0;c<num_chunk_sizes && ok;c++)
+        for (int b=0;b<num_batch_chunks && ok;b++)
+        {
+            set_chunk_size(chunk_sizes[c]);
+            set_batch_chunks(batch_chunks[b]);
+
+            double t1 = autotune_time_ms();
+            ok = write(addr, buf, size, timeout_ms);
+            double t2 = autotune_time_ms();
+            ok = ok && read(addr, buf, size, timeout_ms);
+            double t3 = autotune_time_ms();
+            if (!ok)
+                break;
+
+            double wr_mbs = (size / 1048576.0) / ((t2 - t1) / 1000.0);
+            double rd_mbs = (size / 1048576.0) / ((t3 - t2) / 1000.0);
+            if (verbose)
+                printf("%5d  %5d    %10.1f  %10.1f\n", m_chunk_size, m_batch_chunks, wr_mbs, rd_mbs);
+
+            // Best combined write + read time wins
+            if (best_time == 0 || (t3 - t1) < best_time)
+            {
+                best_time         = t3 - t1;
+                best_chunk_size   = m_chunk_size;
+                best_batch_chunks = m_batch_chunks;
+            }
+        }
+
+    free(buf);
+
+    set_chunk_size(best_chunk_size);
+    set_batch_chunks(best_batch_chunks);
+
+    if (verbose && ok)
+        printf("Best: chunk_size=%d batch_chunks=%d\n", m_chunk_size, m_batch_chunks);
+
+    return ok;
+}
+//-------------------------------------------------------------
+// load_settings: Load tuned parameters (key=value per line)
+//-------------------------------------------------------------
+bool ftdi_axi_driver::load_settings(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (!f)
+        return false;
+
+    char key[64];
+    int  value;
+    while (fscanf(f, " %63[^=]=%d", key, &value) == 2)
+    {
+        if (!strcmp(key, "chunk_size"))
+            set_chunk_size(value);
+        else if (!strcmp(key, "batch_chunks"))
+            set_batch_chunks(value);
+        else if (!strcmp(key, "write_window"))
+            set_write_window(value);
+        else if (!strcmp(key, "read_depth"))
+            set_read_depth(value);
+        else if (!strcmp(key, "stream_reads"))
+            set_stream_reads(value != 0);
+        else if (!strcmp(key, "fence_interval"))
+            set_fence_interval(value);
+        else if (!strcmp(key, "write_combine"))
+            set_write_combining(value);
+        else if (!strcmp(key, "write_combine_us"))
+            set_write_combining_timeout(value);
+    }
+
+    fclose(f);
+    return true;
+}
+//-------------------------------------------------------------
+// save_settings: Save tuned parameters
+//-------------------------------------------------------------
+bool ftdi_axi_driver::save_settings(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "chunk_size=%d\n",   m_chunk_size);
+    fprintf(f, "batch_chunks=%d\n", m_batch_chunks);
+    fprintf(f, "write_window=%d\n", m_wr_window);
+    fprintf(f, "read_depth=%d\n",   m_rd_depth);
+    fprintf(f, "stream_reads=%d\n", m_stream_reads ? 1 : 0);
+    fprintf(f, "fence_interval=%d\n", m_wr_fence);
+    fprintf(f, "write_combine=%d\n", m_wc_max);
+    fprintf(f, "write_combine_us=%d\n", m_wc_timeout_us);
+
+    fclose(f);
+    return true;
+}
+//-------------------------------------------------------------
+// reset_stats: Clear instrumentation counters
+//-------------------------------------------------------------
+void ftdi_axi_driver::reset_stats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+//-------------------------------------------------------------
+// stat_op: Record one completed public operation
+//-------------------------------------------------------------
+void ftdi_axi_driver::stat_op(int op, uint64_t start_ns, bool ok)
+{
+    stats_hist_add(m_stats.latency[op], stats_now_ns() - start_ns);
+    if (!ok)
+        m_stats.errors[op]++;
+}
+//-------------------------------------------------------------
+// print_stats: Human readable dump of the counters
+//-------------------------------------------------------------
+void ftdi_axi_driver::print_stats(FILE *f)
+{
+    static const char *names[AXI_STAT_OPS] = { "read32", "write32", "read", "write", "gpio", "batch" };
+
+    fprintf(f, "%-8s %10s %8s %10s %10s %10s %10s\n", "op", "count", "errors", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+    for (int i=0;i<AXI_STAT_OPS;i++)
+    {
+        tStatsHist &h = m_stats.latency[i];
+        if (h.count == 0)
+            continue;
+
+        fprintf(f, "%-8s %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n", names[i],
+                (unsigned long long)h.count, (unsigned long long)m_stats.errors[i],
+                (h.total_ns / 1000.0) / h.count,
+                stats_hist_percentile(h, 0.50) / 1000.0,
+                stats_hist_percentile(h, 0.99) / 1000.0,
+                h.max_ns / 1000.0);
+    }
+
+    fprintf(f, "commands %llu, out %llu transfers / %llu bytes, in %llu transfers / %llu bytes\n",
+            (unsigned long long)m_stats.commands,
+            (unsigned long long)m_stats.transfers_out, (unsigned long long)m_stats.bytes_sent,
+            (unsigned long long)m_stats.transfers_in, (unsigned long long)m_stats.bytes_received);
+    fprintf(f, "seq errors %llu, short reads %llu, read retries %llu, write ack wait %.3f ms\n",
+            (unsigned long long)m_stats.seq_errors, (unsigned long long)m_stats.short_reads,
+            (unsigned long long)m_stats.read_retries, m_stats.ack_wait_ns / 1000000.0);
+    if (m_stats.cache_hits || m_stats.cache_misses)
+        fprintf(f, "read cache: %llu hits, %llu misses\n",
+                (unsigned long long)m_stats.cache_hits, (unsigned long long)m_stats.cache_misses);
+    if (m_stats.wc_writes)
+        fprintf(f, "write combining: %llu posted write32s in %llu bursts\n",
+                (unsigned long long)m_stats.wc_writes, (unsigned long long)m_stats.wc_bursts);
 }
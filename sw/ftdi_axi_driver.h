@@ -1,12 +1,107 @@
 #ifndef FTDI_AXI_DRIVER_H
 #define FTDI_AXI_DRIVER_H
 
+#include <stdio.h>
 #include "ftdi_driver_api.h"
+#include "ftdi_stats.h"
+#include "ftdi_axi_protocol.h"
+#include "ftdi_axi_cache.h"
 
-#define MAX_WR_CHUNKS   128
-#define MAX_RD_CHUNKS   128
+class ftdi_axi_batch;
 
-#define MAX_CHUNK_SIZE  512
+// Commands per block read/write batch
+#define MAX_BATCH_CHUNKS     128
+#define DEFAULT_BATCH_CHUNKS 128
+
+// Bytes per block read/write command (8-bit word count / AXI len)
+#define MAX_CHUNK_SIZE       (255 * 4)
+#define DEFAULT_CHUNK_SIZE   512
+
+// Outstanding non-posted write batches
+#define MAX_WR_WINDOW        16
+#define DEFAULT_WR_WINDOW    4
+
+// Posted block writes: bytes between non-posted fences
+#define WR_FENCE_BATCH       0      // Every batch
+#define WR_FENCE_END         (-1)   // Only at the end of each write()
+#define DEFAULT_WR_FENCE     WR_FENCE_BATCH
+
+// Posted write32 combining (off by default)
+#define DEFAULT_WC_TIMEOUT_US 1000
+
+// Block read batches in flight (one receive buffer each)
+#define MAX_RD_DEPTH         4
+#define DEFAULT_RD_DEPTH     2
+
+// Receive buffers which can be held by zero-copy read views
+#define MAX_READ_VIEWS       4
+
+// Transfer buffer sizes
+#define CMD_BUF_SIZE         (16 + (255 * 4))
+#define RESP_BUF_SIZE        (4 + (255 * 4))
+#define WRITE_BUF_SIZE       ((MAX_CHUNK_SIZE * MAX_BATCH_CHUNKS) + (16 * MAX_BATCH_CHUNKS))
+#define READ_BUF_SIZE        ((MAX_BATCH_CHUNKS * MAX_CHUNK_SIZE) + (MAX_BATCH_CHUNKS * 4))
+
+//-------------------------------------------------------------
+// tAxiSpan: Target address range <-> host buffer
+//-------------------------------------------------------------
+typedef struct AxiSpan
+{
+    uint32_t addr;
+    uint8_t *data;
+    int      length;
+} tAxiSpan;
+
+//-------------------------------------------------------------
+// tAxiReadView: Block read data left in place in a receive buffer
+//-------------------------------------------------------------
+typedef struct AxiReadView
+{
+    tAxiSpan spans[MAX_BATCH_CHUNKS];       // Data per chunk (in place)
+    uint16_t status[MAX_BATCH_CHUNKS];      // Status per chunk (AXI resp)
+    int      count;
+    int      length;
+
+    // Driver private
+    int      buffer;
+    int      ticket;
+    int      expected;
+    uint16_t seq_num;
+    int      sts_offset[MAX_BATCH_CHUNKS];
+} tAxiReadView;
+
+//-------------------------------------------------------------
+// tAxiDriverStats: Counters since construction / reset_stats()
+//-------------------------------------------------------------
+enum
+{
+    AXI_STAT_READ32,        // read32
+    AXI_STAT_WRITE32,       // write8 / write32
+    AXI_STAT_READ,          // read / readv
+    AXI_STAT_WRITE,         // write / writev
+    AXI_STAT_GPIO,          // gpio_read / gpio_write
+    AXI_STAT_BATCH,         // transact
+    AXI_STAT_OPS
+};
+
+typedef struct AxiDriverStats
+{
+    tStatsHist latency[AXI_STAT_OPS];
+    uint64_t   errors[AXI_STAT_OPS];
+    uint64_t   commands;        // Commands framed
+    uint64_t   transfers_out;
+    uint64_t   transfers_in;
+    uint64_t   bytes_sent;
+    uint64_t   bytes_received;
+    uint64_t   seq_errors;      // Response sequence number mismatches
+    uint64_t   short_reads;     // Port reads returning less than asked for
+    uint64_t   read_retries;    // Block read underflows retried
+    uint64_t   ack_wait_ns;     // Blocked waiting on write batch acks
+    uint64_t   wc_writes;       // Posted write32s taken by write combining
+    uint64_t   wc_bursts;       // Write commands they were combined into
+    uint64_t   cache_hits;      // Reads served by the host line cache
+    uint64_t   cache_misses;    // Reads which filled lines from the target
+} tAxiDriverStats;
 
 //-------------------------------------------------------------
 // ftdi_axi_driver: Wrapper interface for AXI bus master
@@ -15,6 +110,7 @@ class ftdi_axi_driver
 {
 public:
     ftdi_axi_driver(ftdi_driver_api *port);
+    ~ftdi_axi_driver();
 
     bool send_drain(int timeout_ms);
     bool send_echo(uint8_t *data, int length, int timeout_ms = 100);
@@ -24,20 +120,202 @@ public:
     bool write(uint32_t addr, uint8_t *data, int length, int timeout_ms = 100, bool posted = true);
     bool read(uint32_t addr, uint8_t *data, int length, int timeout_ms = 100);
 
+    // Scatter-gather: all spans framed into shared batches
+    bool writev(const tAxiSpan *spans, int count, int timeout_ms = 100);
+    bool readv(const tAxiSpan *spans, int count, int timeout_ms = 100);
+
+    // Zero-copy write staging: reserve framed payload space for a
+    // range (returns bytes reserved, spans point into the staging
+    // buffer), fill the spans, then commit. Spans must be filled
+    // before the next driver call: any other operation sends the
+    // staged writes ahead of its own commands. write_commit() also
+    // sends (and optionally fences) any write-combined posted writes.
+    int  write_reserve(uint32_t addr, int length, tAxiSpan *spans, int max_spans, int &num_spans, int timeout_ms = 100);
+    bool write_commit(bool fence = true, int timeout_ms = 100);
+
+    // Zero-copy block reads: submit claims a receive buffer and
+    // issues one batch (returns bytes covered), wait receives it and
+    // fills in the spans/status in place. Views must be waited on in
+    // submission order with no other transfers in between, and hold
+    // their buffer until released.
+    int  read_view_submit(uint32_t addr, int length, tAxiReadView &view, int timeout_ms = 100);
+    bool read_view_wait(tAxiReadView &view, int timeout_ms = 100);
+    void read_view_release(tAxiReadView &view);
+
     bool gpio_write(uint32_t value, int timeout_ms = 100);
     bool gpio_read(uint32_t &value, int timeout_ms = 100);
 
+    // Address region attributes (AXI_REGION_xxx). Reads of cacheable
+    // regions are served from a host line cache filled with burst
+    // reads, kept coherent with writes made through this driver
+    // (not the async / coroutine engines).
+    bool add_region(uint32_t base, uint32_t size, int attr) { return m_cache.add_region(base, size, attr); }
+    void clear_regions(void) { m_cache.clear_regions(); }
+    void cache_invalidate(uint32_t addr, uint32_t length) { m_cache.invalidate(addr, length); }
+    void cache_invalidate(void) { m_cache.invalidate_all(); }
+
+    // Issue a prepared operation batch (see ftdi_axi_batch and
+    // ftdi_axi_regs) as one OUT transfer and parse the responses.
+    bool transact(ftdi_axi_batch &batch, int timeout_ms = 100);
+
+    void set_write_window(int batches);
+    void set_fence_interval(int bytes);
+
+    // Write combining: posted write32s to adjacent addresses are
+    // merged into bursts and held until max_bytes are pending, the
+    // oldest is timeout_us old (checked on each write and by poll()),
+    // or any other operation is issued. 0 disables. There is no
+    // timer: held writes only go out on a driver call, so call
+    // poll() while otherwise idle.
+    void set_write_combining(int max_bytes);
+    void set_write_combining_timeout(int timeout_us) { m_wc_timeout_us = timeout_us; }
+
+    // Send any posted writes held for combining now. Call before
+    // closing the port - the destructor also flushes, but only
+    // while the port is still open can that succeed.
+    bool flush(int timeout_ms = 100);
+
+    // Idle hook: send held writes once the oldest has timed out
+    bool poll(int timeout_ms = 100);
+    void set_read_depth(int batches);
+    void set_chunk_size(int bytes);
+    void set_batch_chunks(int chunks);
+
+    // Large reads: put the IN pipe in fixed size stream mode for the
+    // whole batches (if the transport supports it)
+    void set_stream_reads(bool enable) { m_stream_reads = enable; }
+
+    int  get_chunk_size(void)   { return m_chunk_size; }
+    int  get_batch_chunks(void) { return m_batch_chunks; }
+    int  get_fence_interval(void) { return m_wr_fence; }
+
+    // Sweep chunk size / batch depth against the target (scratch
+    // memory at addr is overwritten) and apply the best setting.
+    bool autotune(uint32_t addr, int size, int timeout_ms = 1000, bool verbose = true);
+
+    bool load_settings(const char *filename);
+    bool save_settings(const char *filename);
+
+    // Instrumentation (always on)
+    void get_stats(tAxiDriverStats &stats) { stats = m_stats; }
+    void reset_stats(void);
+    void print_stats(FILE *f);
+
 protected:
 
+    int  port_write(uint8_t *data, int length, int timeout_ms);
+    int  port_read(uint8_t *data, int length, int timeout_ms);
+    void stat_op(int op, uint64_t start_ns, bool ok);
+
+    bool write_block(uint32_t addr, uint8_t *data, int length, int timeout_ms, bool posted);
+    bool read_block(uint32_t addr, uint8_t *data, int length, int timeout_ms);
+    bool writev_spans(const tAxiSpan *spans, int count, int timeout_ms);
+    bool readv_spans(const tAxiSpan *spans, int count, int timeout_ms);
+
     bool send_command(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, int timeout_ms);
     uint8_t* recv_data(uint16_t seq_num, int length, int timeout_ms);
     int fill_command(uint8_t *wr_buf, uint8_t cmd_id, uint32_t addr, uint8_t *data, int length);
+    int next_write(uint32_t addr, uint8_t *data, int length, uint8_t &cmd_id, uint32_t &lane);
+
+    bool push_write_ack(uint16_t seq_num, int timeout_ms);
+    bool pop_write_ack(int timeout_ms);
+    bool flush_write_acks(int timeout_ms);
+
+    typedef struct ReadBatch
+    {
+        uint8_t *data;
+        int      chunks;
+        int      expected;
+        uint16_t seq_num;
+        int      chunk_size;
+        int      skip;          // Bytes dropped from the first word
+        int      length;        // Bytes copied out
+    } tReadBatch;
+
+    bool issue_read_batch(uint32_t &addr, uint8_t *&data, int &length, tReadBatch &batch, int timeout_ms);
+    bool complete_read_batch(tReadBatch &batch, uint8_t *rd_buf, int timeout_ms);
+    bool recv_block(uint8_t *rd_buf, int expected, int timeout_ms);
+    bool read_pipelined(uint32_t &addr, uint8_t *&data, int &length, int timeout_ms);
+
+    typedef struct SgRead
+    {
+        uint8_t *data;
+        int      skip;
+        int      length;
+        int      words;
+    } tSgRead;
+
+    bool issue_readv_batch(const tAxiSpan *spans, int count, int &span, int &offset, tReadBatch &batch, tSgRead *desc, int timeout_ms);
+    bool complete_readv_batch(tReadBatch &batch, tSgRead *desc, uint8_t *rd_buf, int timeout_ms);
+
+    bool queue_write(uint8_t cmd_id, uint32_t addr, uint8_t *data, int length, int timeout_ms);
+    bool combine_write32(uint32_t addr, uint32_t data, int timeout_ms);
+    bool flush_combined(int timeout_ms);
+
+    bool cached_read(uint32_t addr, uint8_t *data, int length, int timeout_ms);
+    void cache_write(uint32_t addr, uint8_t *data, int length) { if (m_cache.active()) m_cache.write(addr, data, length); }
+    bool cacheable(uint32_t addr, int length) { return m_cache.active() && m_cache.region_attr(addr, length) != AXI_REGION_UNCACHED; }
+    bool queue_write_bytes(uint32_t addr, uint8_t *data, int length, int timeout_ms);
+    bool queue_fence(int timeout_ms);
+    bool send_write_queue(int timeout_ms);
 
     uint16_t         m_seq_num;
     ftdi_driver_api *m_port;
 
-    uint8_t          m_write_buf[(MAX_CHUNK_SIZE * MAX_WR_CHUNKS) + (16 * MAX_WR_CHUNKS)];
-    uint8_t          m_read_buf[(MAX_RD_CHUNKS * MAX_CHUNK_SIZE) + (MAX_RD_CHUNKS * 4)];
+    // Outstanding write batch acks (ring of seq_nums)
+    int              m_wr_window;
+    uint16_t         m_wr_pending[MAX_WR_WINDOW];
+    int              m_wr_pending_head;
+    int              m_wr_pending_count;
+
+    // Posted block write bytes between fences
+    int              m_wr_fence;
+
+    // Block read batches in flight
+    int              m_rd_depth;
+    bool             m_stream_reads;
+    bool             m_streaming;       // IN pipe currently in stream mode
+
+    // Block transfer framing
+    int              m_chunk_size;
+    int              m_batch_chunks;
+
+    // Posted write batch being built in m_write_buf
+    uint8_t         *m_wr_pos;
+
+    // Write combining (open burst in the queued batch)
+    int              m_wc_max;
+    int              m_wc_timeout_us;
+    bool             m_wc_pending;
+    int              m_wc_bytes;
+    uint64_t         m_wc_start_ns;
+    tCommandBlock   *m_wc_cmd;
+
+    // Scatter-gather read de-framing (per read batch in flight)
+    tSgRead          m_sg_reads[MAX_RD_DEPTH][MAX_BATCH_CHUNKS];
+
+    // Zero-copy read view buffers
+    bool             m_view_held[MAX_READ_VIEWS];
+    int              m_view_submitted;
+    int              m_view_completed;
+
+    // Transfer buffer pool (page aligned, allocated once)
+    uint8_t         *m_pool;
+    uint8_t         *m_cmd_buf;
+    uint8_t         *m_resp_buf;
+    uint8_t         *m_write_buf;
+    uint8_t         *m_read_bufs[MAX_RD_DEPTH];
+    uint8_t         *m_view_bufs[MAX_READ_VIEWS];
+
+    // Region map / host line cache
+    ftdi_axi_cache   m_cache;
+
+    tAxiDriverStats  m_stats;
+
+private:
+    // Owns the buffer pool - not copyable
+    ftdi_axi_driver(const ftdi_axi_driver &);
+    ftdi_axi_driver &operator=(const ftdi_axi_driver &);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,41 @@
+#ifndef FTDI_AXI_PROTOCOL_H
+#define FTDI_AXI_PROTOCOL_H
+
+#include <stdint.h>
+
+//-------------------------------------------------------------
+// Command / status framing (see src_v/ft60x_axi.v)
+//-------------------------------------------------------------
+typedef struct CommandBlock
+{
+    uint8_t  command;
+    uint8_t  length;
+    uint16_t seq_num;
+    uint32_t addr;
+} tCommandBlock;
+
+typedef struct StatusBlock
+{
+    uint16_t seq_num;
+    uint16_t status;
+} tStatusBlock;
+
+#define CMD_ID_ECHO       0x01
+#define CMD_ID_DRAIN      0x02
+#define CMD_ID_READ       0x10
+#define CMD_ID_WRITE8_NP  0x20 // 8-bit write (with response)
+#define CMD_ID_WRITE16_NP 0x21 // 16-bit write (with response)
+#define CMD_ID_WRITE_NP   0x22 // 32-bit write (with response)
+#define CMD_ID_WRITE8     0x30 // 8-bit write
+#define CMD_ID_WRITE16    0x31 // 16-bit write
+#define CMD_ID_WRITE      0x32 // 32-bit write
+#define CMD_ID_GPIO_WR    0x40
+#define CMD_ID_GPIO_RD    0x41
+
+// Posted write command -> equivalent write with response
+#define CMD_ID_NP(_cmd)   ((_cmd) - 0x10)
+
+// Max words per command (8-bit length field / AXI len)
+#define CMD_MAX_WORDS     255
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include "ftdi_axi_regs.h"
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_protocol.h"
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_axi_regs::ftdi_axi_regs(ftdi_axi_driver *driver)
+{
+    m_driver      = driver;
+    m_round_trips = 0;
+}
+//-------------------------------------------------------------
+// clear: Remove all operations
+//-------------------------------------------------------------
+void ftdi_axi_regs::clear(void)
+{
+    m_ops.clear();
+    m_round_trips = 0;
+}
+//-------------------------------------------------------------
+// add: Append an operation
+//-------------------------------------------------------------
+int ftdi_axi_regs::add(uint8_t cmd_id, uint32_t addr, uint32_t value, uint32_t *result)
+{
+    tAxiRegOp op;
+    op.cmd_id = cmd_id;
+    op.addr   = addr;
+    op.value  = value;
+    op.result = result;
+    op.ok     = false;
+    op.status = 0;
+
+    m_ops.push_back(op);
+    return (int)m_ops.size() - 1;
+}
+//-------------------------------------------------------------
+// read32 / write32 / write16 / write8: Register accesses
+//-------------------------------------------------------------
+int ftdi_axi_regs::read32(uint32_t addr, uint32_t *value)
+{
+    return add(CMD_ID_READ, addr & ~3, 0, value);
+}
+int ftdi_axi_regs::write32(uint32_t addr, uint32_t value, bool posted)
+{
+    return add(posted ? CMD_ID_WRITE : CMD_ID_WRITE_NP, addr & ~3, value, NULL);
+}
+int ftdi_axi_regs::write16(uint32_t addr, uint16_t value, bool posted)
+{
+    // Data in its byte lanes
+    return add(posted ? CMD_ID_WRITE16 : CMD_ID_WRITE16_NP, addr & ~1, (uint32_t)value << (8 * (addr & 2)), NULL);
+}
+int ftdi_axi_regs::write8(uint32_t addr, uint8_t value, bool posted)
+{
+    return add(posted ? CMD_ID_WRITE8 : CMD_ID_WRITE8_NP, addr, (uint32_t)value << (8 * (addr & 3)), NULL);
+}
+//-------------------------------------------------------------
+// gpio_write / gpio_read: GPIO accesses
+//-------------------------------------------------------------
+int ftdi_axi_regs::gpio_write(uint32_t value)
+{
+    return add(CMD_ID_GPIO_WR, 0, value, NULL);
+}
+int ftdi_axi_regs::gpio_read(uint32_t *value)
+{
+    return add(CMD_ID_GPIO_RD, 0, 0, value);
+}
+//-------------------------------------------------------------
+// execute: Fill batches in order, one round trip each
+//-------------------------------------------------------------
+bool ftdi_axi_regs::execute(int timeout_ms)
+{
+    int next = 0;
+    int total = (int)m_ops.size();
+
+    while (next < total)
+    {
+        int first = next;
+
+        m_batch.clear();
+        while (next < total)
+        {
+            tAxiRegOp &op = m_ops[next];
+            if (m_batch.add(op.cmd_id, op.addr, NULL, 4, op.value) < 0)
+                break;
+            next++;
+        }
+
+        if (next == first)
+        {
+            fprintf(stderr, "ERROR: Invalid register operation at index %d\n", first);
+            return false;
+        }
+
+        m_round_trips++;
+        if (!m_driver->transact(m_batch, timeout_ms))
+            return false;
+
+        for (int i=0;i<m_batch.count();i++)
+        {
+            tAxiOp    &b  = m_batch.op(i);
+            tAxiRegOp &op = m_ops[first + i];
+
+            op.ok     = b.ok;
+            op.status = b.status;
+            if (op.cmd_id == CMD_ID_READ || op.cmd_id == CMD_ID_GPIO_RD)
+            {
+                op.value = b.value;
+                if (op.result)
+                    *op.result = b.value;
+            }
+        }
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// errors: Count of completed operations with a bad AXI response
+//-------------------------------------------------------------
+int ftdi_axi_regs::errors(void)
+{
+    int count = 0;
+    for (size_t i=0;i<m_ops.size();i++)
+        if (m_ops[i].ok && m_ops[i].status != 0)
+            count++;
+
+    return count;
+}
@@ -0,0 +1,66 @@
+#ifndef FTDI_AXI_REGS_H
+#define FTDI_AXI_REGS_H
+
+#include <stdint.h>
+#include <vector>
+#include "ftdi_axi_batch.h"
+
+class ftdi_axi_driver;
+
+//-------------------------------------------------------------
+// tAxiRegOp: One register access in a sequence
+//-------------------------------------------------------------
+typedef struct AxiRegOp
+{
+    uint8_t   cmd_id;     // CMD_ID_xxx
+    uint32_t  addr;
+    uint32_t  value;      // Write data / read result
+    uint32_t *result;     // Optional read destination
+
+    // Result
+    bool      ok;         // Completed (posted: sent)
+    uint16_t  status;     // AXI resp (operations with a response)
+} tAxiRegOp;
+
+//-------------------------------------------------------------
+// ftdi_axi_regs: Ordered list of register reads, writes, posted
+// writes and GPIO accesses executed with as few round trips as
+// possible (one per BATCH_MAX_OPS operations or MAX_BATCH_CHUNKS
+// responses).
+//-------------------------------------------------------------
+class ftdi_axi_regs
+{
+public:
+    ftdi_axi_regs(ftdi_axi_driver *driver);
+
+    void clear(void);
+
+    // Append an operation, returns its index
+    int  read32(uint32_t addr, uint32_t *value = NULL);
+    int  write32(uint32_t addr, uint32_t value, bool posted = false);
+    int  write16(uint32_t addr, uint16_t value, bool posted = false);
+    int  write8(uint32_t addr, uint8_t value, bool posted = false);
+    int  gpio_write(uint32_t value);
+    int  gpio_read(uint32_t *value = NULL);
+
+    // Run the sequence in order. Returns false once a round trip
+    // fails (later operations are left incomplete).
+    bool execute(int timeout_ms = 100);
+
+    int        count(void)       { return (int)m_ops.size(); }
+    tAxiRegOp &op(int idx)       { return m_ops[idx]; }
+    int        round_trips(void) { return m_round_trips; }
+
+    // Operations which completed with a non-zero AXI response
+    int        errors(void);
+
+protected:
+    int  add(uint8_t cmd_id, uint32_t addr, uint32_t value, uint32_t *result);
+
+    ftdi_axi_driver        *m_driver;
+    std::vector<tAxiRegOp>  m_ops;
+    ftdi_axi_batch          m_batch;
+    int                     m_round_trips;
+};
+
+#endif
@@ -9,11 +9,17 @@
 class ftdi_driver_api
 {
 public:
+    virtual ~ftdi_driver_api() {}
+
     virtual bool open(int device_idx) = 0;
     virtual void close(void) = 0;
     virtual int  read(uint8_t *data, int length, int timout_ms) = 0;
     virtual int  write(uint8_t *data, int length, int timout_ms) = 0;
     virtual void sleep(int wait_us) = 0;
+
+    // Optional: every read() will be exactly 'size' bytes until cleared
+    // with 0. Returns false if the transport cannot do this.
+    virtual bool set_read_stream(int size) { (void)size; return false; }
 };
 
 #endif
\ No newline at end of file
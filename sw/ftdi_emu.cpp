@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ftdi_emu.h"
+#include "ftdi_axi_protocol.h"
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_emu::ftdi_emu()
+{
+    m_last_page   = 0;
+    m_last_ptr    = NULL;
+
+    set_fifo_depth(EMU_DEFAULT_FIFO_WORDS);
+    m_gpio_in     = 0;
+    m_gpio_out    = 0;
+
+    m_bandwidth   = 0;
+    m_latency_us  = 0;
+    m_out_free_us = 0;
+    m_in_free_us  = 0;
+    m_stream_size = 0;
+
+    m_stat_commands  = 0;
+    m_stat_bytes_out = 0;
+    m_stat_bytes_in  = 0;
+
+    reset();
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_emu::~ftdi_emu()
+{
+    for (std::map<uint32_t, uint8_t*>::iterator it = m_pages.begin(); it != m_pages.end(); ++it)
+        free(it->second);
+}
+//-------------------------------------------------------------
+// open / close: Nothing to connect to
+//-------------------------------------------------------------
+bool ftdi_emu::open(int device_idx)
+{
+    (void)device_idx;
+    return true;
+}
+void ftdi_emu::close(void)
+{
+}
+//-------------------------------------------------------------
+// sleep: Wait for some time
+//-------------------------------------------------------------
+void ftdi_emu::sleep(int wait_us)
+{
+    usleep(wait_us);
+}
+//-------------------------------------------------------------
+// set_read_stream: Fixed size IN transfers (0 to clear)
+//-------------------------------------------------------------
+bool ftdi_emu::set_read_stream(int size)
+{
+    m_stream_size = (size > 0) ? size : 0;
+    return true;
+}
+//-------------------------------------------------------------
+// reset: Empty FIFOs, return state machine to idle
+//-------------------------------------------------------------
+void ftdi_emu::reset(void)
+{
+    m_rx.clear();
+    m_rx_pos   = 0;
+    m_tx.clear();
+    m_tx_pos   = 0;
+    m_tx_total = 0;
+    m_tx_ready_head  = 0;
+    m_tx_ready_count = 0;
+    m_hung     = false;
+}
+//-------------------------------------------------------------
+// Link / target model
+//-------------------------------------------------------------
+void ftdi_emu::set_bandwidth(int mbytes_per_sec)
+{
+    m_bandwidth = (mbytes_per_sec > 0) ? mbytes_per_sec : 0;
+}
+void ftdi_emu::set_latency(int latency_us)
+{
+    m_latency_us = (latency_us > 0) ? latency_us : 0;
+}
+void ftdi_emu::set_fifo_depth(int words)
+{
+    // Must hold at least one maximum length response
+    if (words < (CMD_MAX_WORDS + 1))
+        words = CMD_MAX_WORDS + 1;
+
+    m_fifo_bytes = words * 4;
+
+    // FIFO storage is reclaimed once 1MB has been consumed; size it
+    // once so the hot path never allocates.
+    m_rx.reserve((1 << 20) + (2 * m_fifo_bytes));
+    m_tx.reserve((1 << 20) + (2 * m_fifo_bytes));
+
+    // At most one entry per 4 byte status word in the TX FIFO
+    m_tx_ready.resize(words + 1);
+    m_tx_ready_head  = 0;
+    m_tx_ready_count = 0;
+}
+//-------------------------------------------------------------
+// now_us / wait_until: Clock for the link model
+//-------------------------------------------------------------
+double ftdi_emu::now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000.0) + (ts.tv_nsec / 1000.0);
+}
+void ftdi_emu::wait_until(double t_us)
+{
+    double now = now_us();
+
+    // Sleep the bulk, spin the remainder for accuracy
+    if ((t_us - now) > 200.0)
+        usleep((useconds_t)(t_us - now - 100.0));
+
+    while (now_us() < t_us)
+        ;
+}
+//-------------------------------------------------------------
+// page: Find (optionally allocate) the page holding addr
+//-------------------------------------------------------------
+uint8_t *ftdi_emu::page(uint32_t addr, bool alloc)
+{
+    uint32_t key = addr & ~(uint32_t)(EMU_PAGE_SIZE - 1);
+
+    if (m_last_ptr && key == m_last_page)
+        return m_last_ptr;
+
+    uint8_t *p = NULL;
+    std::map<uint32_t, uint8_t*>::iterator it = m_pages.find(key);
+    if (it != m_pages.end())
+        p = it->second;
+    else if (alloc)
+    {
+        p = (uint8_t *)calloc(1, EMU_PAGE_SIZE);
+        m_pages[key] = p;
+    }
+
+    if (p)
+    {
+        m_last_page = key;
+        m_last_ptr  = p;
+    }
+    return p;
+}
+//-------------------------------------------------------------
+// mem_burst: AXI INCR burst of 32-bit beats (with write strobe)
+//-------------------------------------------------------------
+void ftdi_emu::mem_burst(uint32_t addr, uint8_t *data, int words, bool write, uint8_t strb)
+{
+    uint32_t base = addr & ~3;
+
+    for (int i=0;i<words;)
+    {
+        uint32_t a   = base + (i * 4);
+        uint32_t off = a & (EMU_PAGE_SIZE - 1);
+        int      n   = (EMU_PAGE_SIZE - off) / 4;
+        if (n > (words - i))
+            n = words - i;
+
+        uint8_t *p = page(a, write);
+        if (!write)
+        {
+            // Never written memory reads as zero
+            if (p)
+                memcpy(&data[i * 4], &p[off], n * 4);
+            else
+                memset(&data[i * 4], 0, n * 4);
+        }
+        else if (strb == 0xF)
+            memcpy(&p[off], &data[i * 4], n * 4);
+        else
+        {
+            for (int j=0;j<n;j++)
+                for (int b=0;b<4;b++)
+                    if (strb & (1 << b))
+                        p[off + (j * 4) + b] = data[((i + j) * 4) + b];
+        }
+
+        i += n;
+    }
+}
+//-------------------------------------------------------------
+// mem_write / mem_read: Backdoor byte access
+//-------------------------------------------------------------
+void ftdi_emu::mem_write(uint32_t addr, const uint8_t *data, int length)
+{
+    for (int i=0;i<length;i++)
+        page(addr + i, true)[(addr + i) & (EMU_PAGE_SIZE - 1)] = data[i];
+}
+void ftdi_emu::mem_read(uint32_t addr, uint8_t *data, int length)
+{
+    for (int i=0;i<length;i++)
+    {
+        uint8_t *p = page(addr + i, false);
+        data[i] = p ? p[(addr + i) & (EMU_PAGE_SIZE - 1)] : 0;
+    }
+}
+//-------------------------------------------------------------
+// push_tx / push_status: Queue response data for the host
+//-------------------------------------------------------------
+void ftdi_emu::push_tx(const uint8_t *data, int length)
+{
+    m_tx.insert(m_tx.end(), data, data + length);
+    m_tx_total += length;
+}
+void ftdi_emu::push_status(uint16_t seq_num, uint16_t resp)
+{
+    tStatusBlock sts;
+    sts.seq_num = seq_num;
+    sts.status  = resp;
+    push_tx((uint8_t *)&sts, sizeof(sts));
+}
+//-------------------------------------------------------------
+// execute: Run received commands until one is incomplete or its
+// response does not fit in the TX FIFO. Returns true on progress.
+//-------------------------------------------------------------
+bool ftdi_emu::execute(double ready_us)
+{
+    bool progress = false;
+
+    while (!m_hung && rx_level() >= (int)sizeof(tCommandBlock))
+    {
+        const tCommandBlock *cmd = (const tCommandBlock *)&m_rx[m_rx_pos];
+        int words = cmd->length;
+        int need  = sizeof(tCommandBlock);
+        int resp  = 0;
+
+        switch (cmd->command)
+        {
+        case CMD_ID_ECHO:
+            need += words * 4;
+            resp  = (words * 4) + sizeof(tStatusBlock);
+            break;
+        case CMD_ID_DRAIN:
+            break;
+        case CMD_ID_READ:
+            // AXI len = length - 1
+            words = words ? words : 256;
+            resp  = (words * 4) + sizeof(tStatusBlock);
+            break;
+        case CMD_ID_WRITE8_NP:
+        case CMD_ID_WRITE16_NP:
+        case CMD_ID_WRITE_NP:
+            resp  = sizeof(tStatusBlock);
+            // Fall through
+        case CMD_ID_WRITE8:
+        case CMD_ID_WRITE16:
+        case CMD_ID_WRITE:
+            words = words ? words : 256;
+            need += words * 4;
+            break;
+        case CMD_ID_GPIO_WR:
+            need += 4;
+            resp  = sizeof(tStatusBlock);
+            break;
+        case CMD_ID_GPIO_RD:
+            resp  = 4 + sizeof(tStatusBlock);
+            break;
+        default:
+            // The RTL waits forever in STATE_CMD_ADDR
+            fprintf(stderr, "EMU: Unknown command %02x (seq %04x) - target hung\n", cmd->command, cmd->seq_num);
+            m_hung = true;
+            return progress;
+        }
+
+        if (rx_level() < need || (m_fifo_bytes - tx_level()) < resp)
+            break;
+
+        uint8_t *payload = &m_rx[m_rx_pos + sizeof(tCommandBlock)];
+        m_rx_pos += need;
+
+        switch (cmd->command)
+        {
+        case CMD_ID_ECHO:
+            push_tx(payload, words * 4);
+            push_status(cmd->seq_num, 0);
+            break;
+        case CMD_ID_DRAIN:
+            // Discard everything received so far
+            m_rx_pos = m_rx.size();
+            break;
+        case CMD_ID_READ:
+        {
+            size_t pos = m_tx.size();
+            m_tx.resize(pos + (words * 4));
+            m_tx_total += words * 4;
+            mem_burst(cmd->addr, &m_tx[pos], words, false, 0);
+            push_status(cmd->seq_num, 0);
+        }
+        break;
+        case CMD_ID_WRITE8:
+        case CMD_ID_WRITE8_NP:
+            mem_burst(cmd->addr, payload, words, true, 1 << (cmd->addr & 3));
+            break;
+        case CMD_ID_WRITE16:
+        case CMD_ID_WRITE16_NP:
+            mem_burst(cmd->addr, payload, words, true, (cmd->addr & 2) ? 0xC : 0x3);
+            break;
+        case CMD_ID_WRITE:
+        case CMD_ID_WRITE_NP:
+            mem_burst(cmd->addr, payload, words, true, 0xF);
+            break;
+        case CMD_ID_GPIO_WR:
+            memcpy(&m_gpio_out, payload, 4);
+            push_status(cmd->seq_num, 0);
+            break;
+        case CMD_ID_GPIO_RD:
+            push_tx((uint8_t *)&m_gpio_in, 4);
+            push_status(cmd->seq_num, 0);
+            break;
+        }
+
+        if (cmd->command == CMD_ID_WRITE8_NP || cmd->command == CMD_ID_WRITE16_NP || cmd->command == CMD_ID_WRITE_NP)
+            push_status(cmd->seq_num, 0);
+
+        // Note when this response becomes visible to the host
+        if (resp && (m_bandwidth || m_latency_us))
+        {
+            int size = (int)m_tx_ready.size();
+            int last = (m_tx_ready_head + m_tx_ready_count - 1) % size;
+            if (m_tx_ready_count && m_tx_ready[last].ready_us == ready_us)
+                m_tx_ready[last].end = m_tx_total;
+            else
+            {
+                tEmuReady &seg = m_tx_ready[(m_tx_ready_head + m_tx_ready_count) % size];
+                seg.end      = m_tx_total;
+                seg.ready_us = ready_us;
+                m_tx_ready_count++;
+            }
+        }
+
+        m_stat_commands++;
+        progress = true;
+    }
+
+    // Reclaim consumed RX space
+    if (m_rx_pos == (int)m_rx.size())
+    {
+        m_rx.clear();
+        m_rx_pos = 0;
+    }
+    else if (m_rx_pos > (1 << 20))
+    {
+        m_rx.erase(m_rx.begin(), m_rx.begin() + m_rx_pos);
+        m_rx_pos = 0;
+    }
+
+    return progress;
+}
+//-------------------------------------------------------------
+// write: Host to target transfer
+//-------------------------------------------------------------
+int ftdi_emu::write(uint8_t *data, int length, int timeout_ms)
+{
+    bool   timed    = m_bandwidth || m_latency_us;
+    double ready_us = 0;
+
+    // A full target fails the write at once rather than timing out
+    (void)timeout_ms;
+
+    // OUT transfers are serialised on the link
+    if (timed)
+    {
+        double start = now_us();
+        if (start < m_out_free_us)
+            start = m_out_free_us;
+        ready_us = start + m_latency_us + (m_bandwidth ? ((double)length / m_bandwidth) : 0);
+        m_out_free_us = ready_us;
+    }
+
+    int accepted = 0;
+    while (accepted < length)
+    {
+        int space = m_fifo_bytes - rx_level();
+        if (space <= 0)
+        {
+            // The host is blocked here, so nothing will drain the target
+            if (!execute(ready_us))
+                break;
+            continue;
+        }
+
+        int n = length - accepted;
+        if (n > space)
+            n = space;
+
+        m_rx.insert(m_rx.end(), data + accepted, data + accepted + n);
+        accepted += n;
+        execute(ready_us);
+    }
+
+    m_stat_bytes_out += accepted;
+
+    if (timed)
+        wait_until(ready_us);
+
+    if (accepted != length)
+    {
+        fprintf(stderr, "EMU: Write stalled, target FIFOs full (%d/%d bytes)\n", accepted, length);
+        return -1;
+    }
+
+    return length;
+}
+//-------------------------------------------------------------
+// read: Target to host transfer. Returns early (rather than at the
+// timeout) when no more data can be produced.
+//-------------------------------------------------------------
+int ftdi_emu::read(uint8_t *data, int length, int timeout_ms)
+{
+    bool   timed  = m_bandwidth || m_latency_us;
+    double now    = timed ? now_us() : 0;
+    double ready  = 0;
+    int    copied = 0;
+
+    // Nothing more arrives while the host waits - no need to
+    (void)timeout_ms;
+
+    if (m_stream_size && (length % m_stream_size))
+    {
+        fprintf(stderr, "EMU: Read of %d bytes in stream mode (size %d) - timed out\n", length, m_stream_size);
+        return 0;
+    }
+
+    while (copied < length)
+    {
+        // Draining TX may let stalled commands run
+        execute(now);
+
+        int n = tx_level();
+        if (n == 0)
+            break;
+        if (n > (length - copied))
+            n = length - copied;
+
+        memcpy(&data[copied], &m_tx[m_tx_pos], n);
+        m_tx_pos += n;
+        copied   += n;
+
+        // Latest point any of the returned data became available
+        uint64_t consumed = m_tx_total - tx_level();
+        while (m_tx_ready_count)
+        {
+            tEmuReady &seg = m_tx_ready[m_tx_ready_head];
+            if (seg.ready_us > ready)
+                ready = seg.ready_us;
+            if (seg.end > consumed)
+                break;
+            m_tx_ready_head = (m_tx_ready_head + 1) % (int)m_tx_ready.size();
+            m_tx_ready_count--;
+        }
+
+        if (m_tx_pos == (int)m_tx.size())
+        {
+            m_tx.clear();
+            m_tx_pos = 0;
+        }
+        else if (m_tx_pos > (1 << 20))
+        {
+            m_tx.erase(m_tx.begin(), m_tx.begin() + m_tx_pos);
+            m_tx_pos = 0;
+        }
+    }
+
+    if (timed && copied)
+    {
+        double start = now;
+        if (start < ready)
+            start = ready;
+        if (start < m_in_free_us)
+            start = m_in_free_us;
+
+        int latency  = m_stream_size ? 0 : m_latency_us;
+        m_in_free_us = start + latency + (m_bandwidth ? ((double)copied / m_bandwidth) : 0);
+        wait_until(m_in_free_us);
+    }
+
+    m_stat_bytes_in += copied;
+    return copied;
+}
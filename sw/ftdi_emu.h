@@ -0,0 +1,111 @@
+#ifndef FTDI_EMU_H
+#define FTDI_EMU_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "ftdi_driver_api.h"
+
+//-------------------------------------------------------------
+// Defaults (match ft60x_axi / ft60x_fifo)
+//-------------------------------------------------------------
+#define EMU_DEFAULT_FIFO_WORDS  2048
+#define EMU_PAGE_SIZE           (64 * 1024)
+
+//-------------------------------------------------------------
+// ftdi_emu: In-process emulation of the ft60x_axi target.
+//
+// Implements the command protocol against a sparse memory model,
+// with an optional link model (bandwidth per direction, latency per
+// transfer) and target FIFO depth. Commands are executed when fully
+// received and only if their response fits in the TX FIFO, so
+// batching that would stall the real target stalls here too.
+//-------------------------------------------------------------
+class ftdi_emu: public ftdi_driver_api
+{
+public:
+    ftdi_emu();
+    ~ftdi_emu();
+
+    bool open(int device_idx);
+    void close(void);
+    int  read(uint8_t *data, int length, int timeout_ms);
+    int  write(uint8_t *data, int length, int timeout_ms);
+    void sleep(int wait_us);
+
+    // IN stream mode: reads must be whole multiples of size (others
+    // stall until the timeout, as on the FT601), and as the requests
+    // are queued ahead of the host they do not pay the per-transfer
+    // latency.
+    bool set_read_stream(int size);
+
+    // Link / target model (0 = unlimited / none)
+    void set_bandwidth(int mbytes_per_sec);
+    void set_latency(int latency_us);
+    void set_fifo_depth(int words);
+
+    // Target reset (FIFOs and state machine, not memory)
+    void reset(void);
+
+    // Backdoor memory / GPIO access
+    void     mem_write(uint32_t addr, const uint8_t *data, int length);
+    void     mem_read(uint32_t addr, uint8_t *data, int length);
+    void     set_gpio_inputs(uint32_t value) { m_gpio_in = value; }
+    uint32_t get_gpio_outputs(void)          { return m_gpio_out; }
+
+    // Statistics
+    uint64_t get_commands(void)  { return m_stat_commands; }
+    uint64_t get_bytes_out(void) { return m_stat_bytes_out; }
+    uint64_t get_bytes_in(void)  { return m_stat_bytes_in; }
+
+protected:
+    typedef struct EmuReady
+    {
+        uint64_t end;       // TX byte count this segment ends at
+        double   ready_us;  // Time the segment is available to the host
+    } tEmuReady;
+
+    bool     execute(double ready_us);
+    uint8_t *page(uint32_t addr, bool alloc);
+    void     mem_burst(uint32_t addr, uint8_t *data, int words, bool write, uint8_t strb);
+    void     push_tx(const uint8_t *data, int length);
+    void     push_status(uint16_t seq_num, uint16_t resp);
+    int      rx_level(void) { return (int)m_rx.size() - m_rx_pos; }
+    int      tx_level(void) { return (int)m_tx.size() - m_tx_pos; }
+    double   now_us(void);
+    void     wait_until(double t_us);
+
+    // Sparse memory
+    std::map<uint32_t, uint8_t*> m_pages;
+    uint32_t                     m_last_page;
+    uint8_t                     *m_last_ptr;
+
+    // Target FIFOs
+    std::vector<uint8_t>         m_rx;
+    int                          m_rx_pos;
+    std::vector<uint8_t>         m_tx;
+    int                          m_tx_pos;
+    uint64_t                     m_tx_total;
+    std::vector<tEmuReady>       m_tx_ready;     // Ring
+    int                          m_tx_ready_head;
+    int                          m_tx_ready_count;
+    int                          m_fifo_bytes;
+    bool                         m_hung;
+
+    uint32_t                     m_gpio_in;
+    uint32_t                     m_gpio_out;
+
+    // Link model
+    int                          m_bandwidth;
+    int                          m_latency_us;
+    double                       m_out_free_us;
+    double                       m_in_free_us;
+    int                          m_stream_size;
+
+    uint64_t                     m_stat_commands;
+    uint64_t                     m_stat_bytes_out;
+    uint64_t                     m_stat_bytes_in;
+};
+
+#endif
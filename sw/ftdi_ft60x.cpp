@@ -2,12 +2,18 @@
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <time.h>
+#include <sched.h>
 
 #include <stdlib.h>
 
 #include "ftdi_ft60x.h"
 #include "ftd3xx.h"
 
+// 245 FIFO mode: single channel
+#define FT60X_EP_OUT    0x02
+#define FT60X_EP_IN     0x82
+
 //-----------------------------------------------------------------------------
 // configure: Check and update device configuration
 //-----------------------------------------------------------------------------
@@ -101,7 +107,16 @@ bool ftdi_ft60x::configure(int device_idx, uint8_t clock)
 //-------------------------------------------------------------
 ftdi_ft60x::ftdi_ft60x()
 {
-    m_handle = NULL;
+    m_handle      = NULL;
+    m_ovl_depth   = 0;
+    m_ovl_size    = FT60X_XFER_SIZE;
+    m_stream_size = 0;
+    memset(&m_rd_q, 0, sizeof(m_rd_q));
+    memset(&m_wr_q, 0, sizeof(m_wr_q));
+    m_rd_q.ep   = FT60X_EP_IN;
+    m_wr_q.ep   = FT60X_EP_OUT;
+    set_write_wait(FT60X_WAIT_ADAPTIVE);
+    reset_stats();
 }
 //-------------------------------------------------------------
 // open: Try and open FT60x interface and configure
@@ -126,6 +141,15 @@ bool ftdi_ft60x::open(int device_idx)
         return false;
     }
 
+    if (!queue_init(m_rd_q) || !queue_init(m_wr_q))
+    {
+        printf("FT60x: Failed to setup overlapped transfers\n");
+        queue_release(m_rd_q);
+        FT_Close(m_handle);
+        m_handle = NULL;
+        return false;
+    }
+
     return true;
 }
 //-------------------------------------------------------------
@@ -135,13 +159,34 @@ void ftdi_ft60x::close(void)
 {
     if (m_handle != NULL)
     {
+        set_read_stream(0);
+        queue_release(m_wr_q);
+        queue_release(m_rd_q);
         FT_Close(m_handle);
+        m_handle = NULL;
     }
 }
 //-------------------------------------------------------------
 // read: Read a chunk of data
 //-------------------------------------------------------------
 int ftdi_ft60x::read(uint8_t *data, int length, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+    int count   = m_ovl_depth ? read_overlapped(data, length, timeout_ms) : read_pipe(data, length, timeout_ms);
+
+    stats_hist_add(m_stats.read_latency, stats_now_ns() - t0);
+    if (count < 0)
+        m_stats.errors++;
+    else
+    {
+        m_stats.bytes_read += count;
+        if (count < length)
+            m_stats.short_reads++;
+    }
+
+    return count;
+}
+int ftdi_ft60x::read_pipe(uint8_t *data, int length, int timeout_ms)
 {
     DWORD count;
     FT_STATUS err;
@@ -165,6 +210,17 @@ int ftdi_ft60x::read(uint8_t *data, int length, int timeout_ms)
 // write: Write a chunk of data
 //-------------------------------------------------------------
 int ftdi_ft60x::write(uint8_t *data, int length, int timeout_ms)
+{
+    uint64_t t0 = stats_now_ns();
+    int count   = m_ovl_depth ? write_overlapped(data, length, timeout_ms) : write_pipe(data, length, timeout_ms);
+
+    stats_hist_add(m_stats.write_latency, stats_now_ns() - t0);
+    if (count < 0)
+        m_stats.errors++;
+
+    return count;
+}
+int ftdi_ft60x::write_pipe(uint8_t *data, int length, int timeout_ms)
 {
     DWORD count;
 
@@ -180,20 +236,453 @@ int ftdi_ft60x::write(uint8_t *data, int length, int timeout_ms)
     }
 
 #if !defined(_WIN32) && !defined(_WIN64) // Linux / MAC
-    DWORD queued_data = 0;
-    int loops = 0;
-    do
-    {
-        status = FT_GetWriteQueueStatus(m_handle, 0, &queued_data);
-    }
-    while (queued_data != 0);
+    if (!wait_write_complete(timeout_ms))
+        return -1;
 #endif
     if ((int)count != length)
         return -1;
 
+    m_stats.bytes_written += count;
+
     return (int)count;
 }
 //-------------------------------------------------------------
+// set_read_stream: Put the IN pipe in stream mode (fixed size
+// transfers, no per-request short packet handling), 0 to clear.
+// Not available with overlapped transfers, whose IN requests are
+// already queued at the transfer size.
+//-------------------------------------------------------------
+bool ftdi_ft60x::set_read_stream(int size)
+{
+    if (!m_handle || m_ovl_depth)
+        return false;
+
+    if (size == m_stream_size)
+        return true;
+
+    FT_STATUS status;
+    if (size)
+        status = FT_SetStreamPipe(m_handle, false, false, FT60X_EP_IN, size);
+    else
+        status = FT_ClearStreamPipe(m_handle, false, false, FT60X_EP_IN);
+
+    if (status != FT_OK)
+    {
+        printf("FT60x: %s err %d\n", size ? "FT_SetStreamPipe" : "FT_ClearStreamPipe", status);
+        return false;
+    }
+
+    m_stream_size = size;
+    return true;
+}
+//-------------------------------------------------------------
+// set_overlapped: Configure the number of transfers kept queued
+//-------------------------------------------------------------
+bool ftdi_ft60x::set_overlapped(int depth, int xfer_size)
+{
+    if (depth < 0)
+        depth = 0;
+    else if (depth > FT60X_MAX_OVERLAPPED)
+        depth = FT60X_MAX_OVERLAPPED;
+
+    // Whole USB 3.0 packets
+    xfer_size = (xfer_size + 1023) & ~1023;
+    if (xfer_size < 1024)
+        xfer_size = 1024;
+
+    if (m_handle)
+    {
+        queue_release(m_wr_q);
+        queue_release(m_rd_q);
+    }
+
+    m_ovl_depth = depth;
+    m_ovl_size  = xfer_size;
+
+    if (m_handle && !(queue_init(m_rd_q) && queue_init(m_wr_q)))
+    {
+        // Fall back to blocking transfers
+        queue_release(m_wr_q);
+        queue_release(m_rd_q);
+        m_ovl_depth = 0;
+        return false;
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// queue_init: Allocate transfer buffers and OVERLAPPED state
+//-------------------------------------------------------------
+bool ftdi_ft60x::queue_init(tFt60xQueue &q)
+{
+    q.head    = 0;
+    q.count   = 0;
+    q.timeout = -1;
+
+    if (m_ovl_depth == 0)
+        return true;
+
+    q.bufs = (uint8_t *)malloc(m_ovl_depth * m_ovl_size);
+    if (!q.bufs)
+        return false;
+
+    for (int i=0;i<m_ovl_depth;i++)
+    {
+        OVERLAPPED *ov = new OVERLAPPED;
+        memset(ov, 0, sizeof(OVERLAPPED));
+        q.xfer[i].overlapped = ov;
+
+        if (FT_InitializeOverlapped(m_handle, ov) != FT_OK)
+        {
+            printf("FT60x: FT_InitializeOverlapped failed\n");
+
+            // Not initialised - nothing to release for this one
+            delete ov;
+            q.xfer[i].overlapped = NULL;
+            queue_release(q);
+            return false;
+        }
+    }
+
+    return true;
+}
+//-------------------------------------------------------------
+// queue_release: Retire anything in flight and free resources
+//-------------------------------------------------------------
+void ftdi_ft60x::queue_release(tFt60xQueue &q)
+{
+    // Outstanding IN transfers may never complete - cancel them,
+    // OUT transfers are allowed to finish.
+    if (q.count && (q.ep & 0x80))
+        FT_AbortPipe(m_handle, q.ep);
+
+    while (q.count)
+    {
+        tFt60xXfer &x = q.xfer[q.head];
+        if (x.done < 0)
+        {
+            ULONG xferred = 0;
+            FT_GetOverlappedResult(m_handle, (LPOVERLAPPED)x.overlapped, &xferred, true);
+        }
+        q.head = (q.head + 1) % m_ovl_depth;
+        q.count--;
+    }
+
+    for (int i=0;i<FT60X_MAX_OVERLAPPED;i++)
+    {
+        if (q.xfer[i].overlapped)
+        {
+            FT_ReleaseOverlapped(m_handle, (LPOVERLAPPED)q.xfer[i].overlapped);
+            delete (OVERLAPPED *)q.xfer[i].overlapped;
+            q.xfer[i].overlapped = NULL;
+        }
+    }
+
+    free(q.bufs);
+    q.bufs = NULL;
+}
+//-------------------------------------------------------------
+// queue_submit: Queue a transfer behind those already in flight
+//-------------------------------------------------------------
+bool ftdi_ft60x::queue_submit(tFt60xQueue &q, uint8_t *data, int length)
+{
+    if (q.count >= m_ovl_depth)
+        return false;
+
+    tFt60xXfer &x = q.xfer[(q.head + q.count) % m_ovl_depth];
+    x.data   = data;
+    x.length = length;
+    x.done   = -1;
+    x.pos    = 0;
+
+    ULONG     xferred = 0;
+    FT_STATUS status;
+    if (q.ep & 0x80)
+        status = FT_ReadPipe(m_handle, q.ep, data, length, &xferred, (LPOVERLAPPED)x.overlapped);
+    else
+        status = FT_WritePipe(m_handle, q.ep, data, length, &xferred, (LPOVERLAPPED)x.overlapped);
+
+    if (status == FT_OK)
+        x.done = (int)xferred;
+    else if (status != FT_IO_PENDING)
+    {
+        printf("FT60x: Overlapped submit (ep %02x) err %d\n", q.ep, status);
+        return false;
+    }
+
+    q.count++;
+    return true;
+}
+//-------------------------------------------------------------
+// queue_wait: Wait for the oldest transfer to complete.
+// Returns -1 on error, otherwise 0 (check x.done for timeout).
+//-------------------------------------------------------------
+int ftdi_ft60x::queue_wait(tFt60xQueue &q, int timeout_ms)
+{
+    if (q.count == 0)
+        return -1;
+
+    tFt60xXfer &x = q.xfer[q.head];
+    if (x.done >= 0)
+        return 0;
+
+    if (timeout_ms != q.timeout)
+    {
+        FT_SetPipeTimeout(m_handle, q.ep, timeout_ms);
+        q.timeout = timeout_ms;
+    }
+
+    ULONG     xferred = 0;
+    FT_STATUS status  = FT_GetOverlappedResult(m_handle, (LPOVERLAPPED)x.overlapped, &xferred, true);
+    if (status == FT_OK)
+        x.done = (int)xferred;
+    else if (status != FT_TIMEOUT && status != FT_IO_PENDING)
+    {
+        printf("FT60x: FT_GetOverlappedResult (ep %02x) err %d\n", q.ep, status);
+        return -1;
+    }
+
+    return 0;
+}
+//-------------------------------------------------------------
+// read_submit: Queue an IN transfer into a caller buffer
+//-------------------------------------------------------------
+bool ftdi_ft60x::read_submit(uint8_t *data, int length)
+{
+    return m_ovl_depth && queue_submit(m_rd_q, data, length);
+}
+//-------------------------------------------------------------
+// read_complete: Wait for the oldest IN transfer. Returns bytes
+// received, 0 if still pending at timeout, -1 on error.
+//-------------------------------------------------------------
+int ftdi_ft60x::read_complete(int timeout_ms)
+{
+    if (queue_wait(m_rd_q, timeout_ms) < 0)
+        return -1;
+
+    tFt60xXfer &x = m_rd_q.xfer[m_rd_q.head];
+    if (x.done < 0)
+        return 0;
+
+    m_rd_q.head = (m_rd_q.head + 1) % m_ovl_depth;
+    m_rd_q.count--;
+    return x.done;
+}
+//-------------------------------------------------------------
+// write_submit: Queue an OUT transfer from a caller buffer
+//-------------------------------------------------------------
+bool ftdi_ft60x::write_submit(uint8_t *data, int length)
+{
+    return m_ovl_depth && queue_submit(m_wr_q, data, length);
+}
+//-------------------------------------------------------------
+// write_complete: Wait for the oldest OUT transfer. Returns bytes
+// sent, 0 if still pending at timeout, -1 on error.
+//-------------------------------------------------------------
+int ftdi_ft60x::write_complete(int timeout_ms)
+{
+    if (queue_wait(m_wr_q, timeout_ms) < 0)
+        return -1;
+
+    tFt60xXfer &x = m_wr_q.xfer[m_wr_q.head];
+    if (x.done < 0)
+        return 0;
+
+    m_wr_q.head = (m_wr_q.head + 1) % m_ovl_depth;
+    m_wr_q.count--;
+    m_stats.bytes_written += x.done;
+    return x.done;
+}
+//-------------------------------------------------------------
+// read_overlapped: read() with every IN transfer kept queued. The
+// IN pipe is treated as a byte stream so short packets simply
+// complete a transfer early.
+//-------------------------------------------------------------
+int ftdi_ft60x::read_overlapped(uint8_t *data, int length, int timeout_ms)
+{
+    tFt60xQueue &q = m_rd_q;
+    int copied = 0;
+
+    while (copied < length)
+    {
+        // Keep the host controller supplied with IN requests
+        while (q.count < m_ovl_depth)
+        {
+            int idx = (q.head + q.count) % m_ovl_depth;
+            if (!queue_submit(q, &q.bufs[idx * m_ovl_size], m_ovl_size))
+                return -1;
+        }
+
+        tFt60xXfer &x = q.xfer[q.head];
+        if (queue_wait(q, timeout_ms) < 0)
+            return -1;
+
+        // Timeout - return what we have
+        if (x.done < 0)
+            break;
+
+        int size = x.done - x.pos;
+        if (size > (length - copied))
+            size = length - copied;
+
+        memcpy(&data[copied], &x.data[x.pos], size);
+        x.pos  += size;
+        copied += size;
+
+        if (x.pos == x.done)
+        {
+            q.head = (q.head + 1) % m_ovl_depth;
+            q.count--;
+        }
+    }
+
+    return copied;
+}
+//-------------------------------------------------------------
+// write_overlapped: write() returning once the data is queued,
+// only waiting when every OUT transfer is in flight.
+//-------------------------------------------------------------
+int ftdi_ft60x::write_overlapped(uint8_t *data, int length, int timeout_ms)
+{
+    tFt60xQueue &q = m_wr_q;
+    int offset = 0;
+
+    while (offset < length)
+    {
+        if (q.count == m_ovl_depth)
+        {
+            tFt60xXfer &x = q.xfer[q.head];
+            uint64_t t0 = stats_now_ns();
+            int len = write_complete(timeout_ms);
+            m_stats.write_waits++;
+            m_stats.write_wait_ns += stats_now_ns() - t0;
+            if (len != x.length)
+            {
+                printf("FT60x: Overlapped write failed (%d/%d)\n", len, x.length);
+                return -1;
+            }
+        }
+
+        int size = length - offset;
+        if (size > m_ovl_size)
+            size = m_ovl_size;
+
+        uint8_t *buf = &q.bufs[((q.head + q.count) % m_ovl_depth) * m_ovl_size];
+        memcpy(buf, &data[offset], size);
+        if (!queue_submit(q, buf, size))
+            return -1;
+
+        offset += size;
+    }
+
+    return length;
+}
+//-------------------------------------------------------------
+// set_write_wait: Select how write() waits for the OUT queue to drain
+//-------------------------------------------------------------
+void ftdi_ft60x::set_write_wait(int mode, int spin_us, int yield_us, int max_sleep_us)
+{
+    m_wait_mode     = mode;
+    m_wait_spin_us  = spin_us;
+    m_wait_yield_us = (yield_us > spin_us) ? yield_us : spin_us;
+    m_wait_sleep_us = (max_sleep_us > 0) ? max_sleep_us : 1;
+}
+#if !defined(_WIN32) && !defined(_WIN64) // Linux / MAC
+//-------------------------------------------------------------
+// time_ns: Clock helper
+//-------------------------------------------------------------
+static uint64_t time_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+//-------------------------------------------------------------
+// wait_write_complete: Wait for queued OUT data to be sent.
+// Spins for the first spin_us, yields until yield_us, then sleeps
+// with exponential back-off, giving up after timeout_ms.
+//-------------------------------------------------------------
+bool ftdi_ft60x::wait_write_complete(int timeout_ms)
+{
+    if (m_wait_mode == FT60X_WAIT_NONE)
+        return true;
+
+    uint64_t cpu_start = time_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t start     = time_ns(CLOCK_MONOTONIC);
+    uint64_t deadline  = start + ((uint64_t)timeout_ms * 1000000ULL);
+    int      sleep_us  = 10;
+    bool     ok        = true;
+
+    while (true)
+    {
+        DWORD queued_data = 0;
+        FT_STATUS status = FT_GetWriteQueueStatus(m_handle, 0, &queued_data);
+        if (status != FT_OK)
+        {
+            printf("FT_GetWriteQueueStatus: %d\n", status);
+            ok = false;
+            break;
+        }
+
+        if (queued_data == 0)
+            break;
+
+        uint64_t now = time_ns(CLOCK_MONOTONIC);
+        if (timeout_ms > 0 && now > deadline)
+        {
+            printf("FT60x: Write completion timeout (%d bytes queued)\n", (int)queued_data);
+            ok = false;
+            break;
+        }
+
+        if (m_wait_mode == FT60X_WAIT_SPIN)
+            continue;
+
+        int elapsed_us = (int)((now - start) / 1000);
+        if (elapsed_us < m_wait_spin_us)
+            continue;
+        else if (elapsed_us < m_wait_yield_us)
+            sched_yield();
+        else
+        {
+            usleep(sleep_us);
+            sleep_us = (sleep_us * 2 > m_wait_sleep_us) ? m_wait_sleep_us : sleep_us * 2;
+        }
+    }
+
+    m_stats.write_waits++;
+    m_stats.write_wait_ns     += time_ns(CLOCK_MONOTONIC) - start;
+    m_stats.write_wait_cpu_ns += time_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    return ok;
+}
+#endif
+//-------------------------------------------------------------
+// reset_write_stats: Clear write statistics
+//-------------------------------------------------------------
+void ftdi_ft60x::reset_write_stats(void)
+{
+    m_stats.bytes_written     = 0;
+    m_stats.write_wait_cpu_ns = 0;
+}
+//-------------------------------------------------------------
+// reset_stats: Clear all transport counters
+//-------------------------------------------------------------
+void ftdi_ft60x::reset_stats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+//-------------------------------------------------------------
+// get_write_cpu_per_mb: CPU milliseconds spent in completion wait
+// per MB written.
+//-------------------------------------------------------------
+double ftdi_ft60x::get_write_cpu_per_mb(void)
+{
+    if (m_stats.bytes_written == 0)
+        return 0.0;
+
+    return (m_stats.write_wait_cpu_ns / 1000000.0) / (m_stats.bytes_written / (1024.0 * 1024.0));
+}
+//-------------------------------------------------------------
 // sleep: Wait for some time
 //-------------------------------------------------------------
 void ftdi_ft60x::sleep(int wait_us)
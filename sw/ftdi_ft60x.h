@@ -2,6 +2,55 @@
 #define FTDI_FT60x_H
 
 #include "ftdi_driver_api.h"
+#include "ftdi_stats.h"
+
+//-------------------------------------------------------------
+// Write completion wait strategies
+//-------------------------------------------------------------
+#define FT60X_WAIT_SPIN      0  // Poll the OUT queue continuously
+#define FT60X_WAIT_ADAPTIVE  1  // Spin briefly, then yield, then sleep
+#define FT60X_WAIT_NONE      2  // Return once the transfer is queued
+
+//-------------------------------------------------------------
+// Overlapped transfers
+//-------------------------------------------------------------
+#define FT60X_MAX_OVERLAPPED  16
+#define FT60X_XFER_SIZE       (64 * 1024)
+
+typedef struct Ft60xXfer
+{
+    void    *overlapped;    // OVERLAPPED (ftd3xx.h)
+    uint8_t *data;
+    int      length;
+    int      done;          // Bytes transferred (-1: still pending)
+    int      pos;           // Bytes consumed by read()
+} tFt60xXfer;
+
+typedef struct Ft60xQueue
+{
+    uint8_t    ep;
+    tFt60xXfer xfer[FT60X_MAX_OVERLAPPED];
+    uint8_t   *bufs;        // Internal buffers used by read() / write()
+    int        head;        // Oldest in flight
+    int        count;       // In flight
+    int        timeout;     // Current pipe timeout
+} tFt60xQueue;
+
+//-------------------------------------------------------------
+// tFt60xStats: Transport counters since construction / reset_stats()
+//-------------------------------------------------------------
+typedef struct Ft60xStats
+{
+    tStatsHist read_latency;        // Per read() call
+    tStatsHist write_latency;       // Per write() call
+    uint64_t   bytes_read;
+    uint64_t   bytes_written;       // Completed OUT transfers
+    uint64_t   short_reads;         // read() returned less than asked for
+    uint64_t   errors;
+    uint64_t   write_waits;         // Completion / full queue waits
+    uint64_t   write_wait_ns;
+    uint64_t   write_wait_cpu_ns;
+} tFt60xStats;
 
 //-------------------------------------------------------------
 // ftdi_ft60x: FT60x interface
@@ -15,12 +64,59 @@ public:
     int  read(uint8_t *data, int length, int timeout_ms);
     int  write(uint8_t *data, int length, int timeout_ms);
     void sleep(int wait_us);
+    bool set_read_stream(int size);
+
+    // Completion wait after each write (spin_us/yield_us: phase lengths)
+    void set_write_wait(int mode, int spin_us = 20, int yield_us = 200, int max_sleep_us = 1000);
+
+    // Keep up to 'depth' transfers of xfer_size queued in each
+    // direction (0 = one blocking transfer at a time). On failure
+    // the port is left using blocking transfers.
+    bool set_overlapped(int depth, int xfer_size = FT60X_XFER_SIZE);
+
+    // Raw submit / complete (caller owned buffers, completed in order).
+    // Not to be mixed with read() / write() when overlapped is enabled.
+    bool read_submit(uint8_t *data, int length);
+    int  read_complete(int timeout_ms);
+    bool write_submit(uint8_t *data, int length);
+    int  write_complete(int timeout_ms);
+
+    // CPU time spent waiting for write completion
+    void   reset_write_stats(void);
+    double get_write_cpu_per_mb(void);
+
+    // Instrumentation (always on)
+    void   get_stats(tFt60xStats &stats) { stats = m_stats; }
+    void   reset_stats(void);
 
 protected:
     bool configure(int device_idx, uint8_t clock);
+    bool wait_write_complete(int timeout_ms);
+    int  read_pipe(uint8_t *data, int length, int timeout_ms);
+    int  write_pipe(uint8_t *data, int length, int timeout_ms);
+
+    virtual bool queue_init(tFt60xQueue &q);
+    void queue_release(tFt60xQueue &q);
+    bool queue_submit(tFt60xQueue &q, uint8_t *data, int length);
+    int  queue_wait(tFt60xQueue &q, int timeout_ms);
+    int  read_overlapped(uint8_t *data, int length, int timeout_ms);
+    int  write_overlapped(uint8_t *data, int length, int timeout_ms);
 
 protected:
     void *m_handle;
+
+    int         m_ovl_depth;
+    int         m_ovl_size;
+    tFt60xQueue m_rd_q;
+    tFt60xQueue m_wr_q;
+    int         m_stream_size;
+
+    int      m_wait_mode;
+    int      m_wait_spin_us;
+    int      m_wait_yield_us;
+    int      m_wait_sleep_us;
+
+    tFt60xStats m_stats;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "ftdi_read_ahead.h"
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_read_ahead::ftdi_read_ahead()
+{
+    m_fd       = -1;
+    m_size     = 0;
+    m_chunk    = 0;
+    m_filled   = 0;
+    m_consumed = 0;
+    m_abort    = false;
+    m_wait     = 0;
+
+    for (int i=0;i<READ_AHEAD_BUFFERS;i++)
+    {
+        m_bufs[i]    = NULL;
+        m_lengths[i] = 0;
+    }
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_read_ahead::~ftdi_read_ahead()
+{
+    close();
+}
+//-------------------------------------------------------------
+// open: Open the file and start the reader thread
+//-------------------------------------------------------------
+bool ftdi_read_ahead::open(const char *filename, int64_t size_override, int chunk)
+{
+    close();
+
+    struct stat st;
+    m_fd = ::open(filename, O_RDONLY);
+    if (m_fd < 0 || fstat(m_fd, &st) != 0 || chunk <= 0)
+    {
+        close();
+        return false;
+    }
+
+    m_size = st.st_size;
+    if (size_override >= 0 && m_size > (uint64_t)size_override)
+        m_size = size_override;
+
+    m_chunk    = chunk;
+    m_filled   = 0;
+    m_consumed = 0;
+    m_abort    = false;
+    m_wait     = 0;
+    for (int i=0;i<READ_AHEAD_BUFFERS;i++)
+    {
+        m_bufs[i]    = new uint8_t[chunk];
+        m_lengths[i] = 0;
+    }
+
+    posix_fadvise(m_fd, 0, m_size, POSIX_FADV_SEQUENTIAL);
+    m_thread = std::thread(&ftdi_read_ahead::reader, this);
+    return true;
+}
+//-------------------------------------------------------------
+// close: Stop the reader thread and free the buffers
+//-------------------------------------------------------------
+void ftdi_read_ahead::close(void)
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_abort = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    for (int i=0;i<READ_AHEAD_BUFFERS;i++)
+    {
+        delete[] m_bufs[i];
+        m_bufs[i] = NULL;
+    }
+
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+}
+//-------------------------------------------------------------
+// next: Wait for the oldest unreleased chunk
+//-------------------------------------------------------------
+int ftdi_read_ahead::next(uint8_t *&data)
+{
+    double t0 = ftdi_time_now();
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_cond.wait(guard, [this] { return m_filled > m_consumed; });
+    m_wait += ftdi_time_now() - t0;
+
+    int idx = m_consumed % READ_AHEAD_BUFFERS;
+    data = m_bufs[idx];
+    return m_lengths[idx];
+}
+//-------------------------------------------------------------
+// release: Hand the oldest chunk buffer back to the reader
+//-------------------------------------------------------------
+void ftdi_read_ahead::release(void)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_consumed++;
+    }
+    m_cond.notify_all();
+}
+//-------------------------------------------------------------
+// reader: Fill free buffers in file order
+//-------------------------------------------------------------
+void ftdi_read_ahead::reader(void)
+{
+    uint64_t offset = 0;
+
+    while (offset < m_size)
+    {
+        uint64_t idx;
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_cond.wait(guard, [this] { return m_abort || (m_filled - m_consumed) < READ_AHEAD_BUFFERS; });
+            if (m_abort)
+                return;
+            idx = m_filled;
+        }
+
+        uint8_t *buf    = m_bufs[idx % READ_AHEAD_BUFFERS];
+        int      length = ((m_size - offset) < (uint64_t)m_chunk) ? (int)(m_size - offset) : m_chunk;
+        int      got    = 0;
+        while (got < length)
+        {
+            ssize_t len = pread(m_fd, buf + got, length - got, offset + got);
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len <= 0)
+            {
+                got = -1;
+                break;
+            }
+            got += len;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_lengths[idx % READ_AHEAD_BUFFERS] = got;
+            m_filled++;
+        }
+        m_cond.notify_all();
+
+        if (got < 0)
+            return;
+        offset += length;
+    }
+}
+//-------------------------------------------------------------
+// ftdi_time_now / ftdi_cpu_now: Wall clock / process CPU (seconds)
+//-------------------------------------------------------------
+double ftdi_time_now(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + (t.tv_usec / 1000000.0);
+}
+double ftdi_cpu_now(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1000000.0) +
+           usage.ru_stime.tv_sec + (usage.ru_stime.tv_usec / 1000000.0);
+}
+//-------------------------------------------------------------
+// ftdi_print_progress: Live transfer progress and throughput
+//-------------------------------------------------------------
+void ftdi_print_progress(uint64_t done, uint64_t size, double elapsed)
+{
+    double mb = done / (1024.0 * 1024.0);
+    printf("\r%10.1f / %.1f MB (%3d%%) %8.2f MB/s", mb, size / (1024.0 * 1024.0),
+           size ? (int)((done * 100) / size) : 100, elapsed > 0 ? mb / elapsed : 0.0);
+    fflush(stdout);
+}
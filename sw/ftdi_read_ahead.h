@@ -0,0 +1,71 @@
+#ifndef FTDI_READ_AHEAD_H
+#define FTDI_READ_AHEAD_H
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//-------------------------------------------------------------
+// Defaults
+//-------------------------------------------------------------
+#define READ_AHEAD_BUFFERS          4
+#define READ_AHEAD_DEFAULT_CHUNK    (4 * 1024 * 1024)
+
+//-------------------------------------------------------------
+// ftdi_read_ahead: Streams a file through a ring of chunk buffers.
+// A reader thread keeps up to READ_AHEAD_BUFFERS chunks ahead of
+// the consumer, so disk reads overlap USB transfers and memory use
+// does not depend on the file size.
+//-------------------------------------------------------------
+class ftdi_read_ahead
+{
+public:
+    ftdi_read_ahead();
+    ~ftdi_read_ahead();
+
+    // Open and start reading (size_override < 0: whole file)
+    bool     open(const char *filename, int64_t size_override, int chunk);
+    void     close(void);
+
+    uint64_t size(void)  { return m_size; }
+    int      chunk(void) { return m_chunk; }
+
+    // Next chunk in file order, waiting until it has been read.
+    // Returns its length (< 0: read error). The data stays valid
+    // until release().
+    int      next(uint8_t *&data);
+    void     release(void);
+
+    // Time spent in next() waiting for the disk (seconds)
+    double   get_wait_time(void) { return m_wait; }
+
+protected:
+    void     reader(void);
+
+    int                     m_fd;
+    uint64_t                m_size;
+    int                     m_chunk;
+    uint8_t                *m_bufs[READ_AHEAD_BUFFERS];
+    int                     m_lengths[READ_AHEAD_BUFFERS];  // <0: read error
+    uint64_t                m_filled;                       // Chunks read
+    uint64_t                m_consumed;                     // Chunks released
+    bool                    m_abort;
+    double                  m_wait;
+    std::mutex              m_lock;
+    std::condition_variable m_cond;
+    std::thread             m_thread;
+
+private:
+    ftdi_read_ahead(const ftdi_read_ahead &);
+    ftdi_read_ahead &operator=(const ftdi_read_ahead &);
+};
+
+//-------------------------------------------------------------
+// Helpers shared by the streaming tools (load / verify)
+//-------------------------------------------------------------
+double ftdi_time_now(void);     // Wall clock (seconds)
+double ftdi_cpu_now(void);      // Process CPU time (seconds)
+void   ftdi_print_progress(uint64_t done, uint64_t size, double elapsed);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef FTDI_STATS_H
+#define FTDI_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+//-------------------------------------------------------------
+// tStatsHist: Latency histogram with power of two buckets
+// (bucket n counts samples in [2^n, 2^(n+1)) ns)
+//-------------------------------------------------------------
+#define STATS_HIST_BUCKETS  40
+
+typedef struct StatsHist
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t bucket[STATS_HIST_BUCKETS];
+} tStatsHist;
+
+//-------------------------------------------------------------
+// stats_now_ns: Monotonic timestamp
+//-------------------------------------------------------------
+static inline uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+//-------------------------------------------------------------
+// stats_hist_add: Record one sample
+//-------------------------------------------------------------
+static inline void stats_hist_add(tStatsHist &h, uint64_t ns)
+{
+    int b = ns ? (63 - __builtin_clzll(ns)) : 0;
+    if (b >= STATS_HIST_BUCKETS)
+        b = STATS_HIST_BUCKETS - 1;
+
+    h.bucket[b]++;
+    h.count++;
+    h.total_ns += ns;
+    if (ns > h.max_ns)
+        h.max_ns = ns;
+}
+//-------------------------------------------------------------
+// stats_hist_percentile: Upper bound (ns) of the bucket holding
+// the p'th sample (0.0 - 1.0)
+//-------------------------------------------------------------
+static inline uint64_t stats_hist_percentile(const tStatsHist &h, double p)
+{
+    if (h.count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p * h.count);
+    uint64_t seen = 0;
+    for (int b=0;b<STATS_HIST_BUCKETS;b++)
+    {
+        seen += h.bucket[b];
+        if (seen > rank)
+        {
+            uint64_t upper = (2ULL << b) - 1;
+            return (upper < h.max_ns) ? upper : h.max_ns;
+        }
+    }
+
+    return h.max_ns;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "ftdi_trace.h"
+
+#define TRACE_HEADER_SIZE   64
+#define TRACE_ALIGN(_x)     (((_x) + 7) & ~(uint64_t)7)
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_trace::ftdi_trace(ftdi_driver_api *port)
+{
+    m_port     = port;
+    m_fd       = -1;
+    m_map      = NULL;
+    m_map_size = 0;
+    m_hdr      = NULL;
+    m_ring     = NULL;
+    m_start_ns = 0;
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_trace::~ftdi_trace()
+{
+    stop();
+}
+//-------------------------------------------------------------
+// start: Create and map the trace file
+//-------------------------------------------------------------
+bool ftdi_trace::start(const char *filename, uint64_t capacity)
+{
+    stop();
+
+    capacity = TRACE_ALIGN(capacity);
+    if (capacity < 4096)
+        capacity = 4096;
+
+    m_fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+    {
+        fprintf(stderr, "ERROR: Could not create trace file %s\n", filename);
+        return false;
+    }
+
+    m_map_size = TRACE_HEADER_SIZE + capacity;
+    if (ftruncate(m_fd, m_map_size) != 0)
+    {
+        fprintf(stderr, "ERROR: Could not size trace file %s\n", filename);
+        stop();
+        return false;
+    }
+
+    void *p = mmap(NULL, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Could not map trace file %s\n", filename);
+        stop();
+        return false;
+    }
+
+    m_map  = (uint8_t *)p;
+    m_hdr  = (tTraceHeader *)m_map;
+    m_ring = m_map + TRACE_HEADER_SIZE;
+
+    memset(m_hdr, 0, sizeof(tTraceHeader));
+    m_hdr->version     = TRACE_VERSION;
+    m_hdr->header_size = TRACE_HEADER_SIZE;
+    m_hdr->capacity    = capacity;
+    m_hdr->start_time  = (uint64_t)time(NULL);
+    m_hdr->magic       = TRACE_MAGIC;
+
+    m_start_ns = now_ns();
+    return true;
+}
+//-------------------------------------------------------------
+// stop: Flush and unmap the trace file
+//-------------------------------------------------------------
+void ftdi_trace::stop(void)
+{
+    if (m_map)
+    {
+        msync(m_map, m_map_size, MS_SYNC);
+        munmap(m_map, m_map_size);
+    }
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd   = -1;
+    m_map  = NULL;
+    m_hdr  = NULL;
+    m_ring = NULL;
+}
+//-------------------------------------------------------------
+// now_ns: Monotonic time
+//-------------------------------------------------------------
+uint64_t ftdi_trace::now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+//-------------------------------------------------------------
+// drop_oldest: Release the record (or wrap gap) at the tail
+//-------------------------------------------------------------
+void ftdi_trace::drop_oldest(void)
+{
+    uint64_t room = m_hdr->capacity - (m_hdr->tail % m_hdr->capacity);
+    if (room < sizeof(tTraceRecord))
+    {
+        m_hdr->tail += room;
+        return;
+    }
+
+    const tTraceRecord *rec = (const tTraceRecord *)ring(m_hdr->tail);
+    m_hdr->tail += sizeof(tTraceRecord) + TRACE_ALIGN(rec->data_len);
+    if (rec->type != TRACE_REC_PAD)
+    {
+        m_hdr->records--;
+        m_hdr->dropped++;
+    }
+}
+//-------------------------------------------------------------
+// record: Append a record, overwriting the oldest if needed
+//-------------------------------------------------------------
+void ftdi_trace::record(uint8_t type, uint32_t length, int timeout_ms, int32_t result, uint64_t start_ns, const uint8_t *data, int data_len)
+{
+    if (!m_hdr)
+        return;
+
+    uint64_t cap   = m_hdr->capacity;
+    uint8_t  flags = 0;
+
+    if (data_len < 0 || !data)
+        data_len = 0;
+
+    uint64_t size = sizeof(tTraceRecord) + TRACE_ALIGN(data_len);
+    if (size > (cap / 2))
+    {
+        flags   |= TRACE_FLAG_TRUNCATED;
+        data_len = 0;
+        size     = sizeof(tTraceRecord);
+    }
+
+    // Records do not straddle the end of the ring
+    uint64_t head = m_hdr->head;
+    uint64_t room = cap - (head % cap);
+    uint64_t need = (room < size) ? (room + size) : size;
+
+    while ((head + need - m_hdr->tail) > cap)
+        drop_oldest();
+
+    if (room < size)
+    {
+        if (room >= sizeof(tTraceRecord))
+        {
+            tTraceRecord *pad = (tTraceRecord *)ring(head);
+            memset(pad, 0, sizeof(tTraceRecord));
+            pad->type     = TRACE_REC_PAD;
+            pad->data_len = room - sizeof(tTraceRecord);
+        }
+        head += room;
+    }
+
+    uint64_t end_ns   = now_ns();
+    uint64_t duration = end_ns - start_ns;
+
+    tTraceRecord *rec = (tTraceRecord *)ring(head);
+    rec->type        = type;
+    rec->flags       = flags;
+    rec->timeout_ms  = (timeout_ms < 0) ? 0 : ((timeout_ms > 0xFFFF) ? 0xFFFF : timeout_ms);
+    rec->length      = length;
+    rec->result      = result;
+    rec->duration_ns = (duration > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (uint32_t)duration;
+    rec->time_ns     = start_ns - m_start_ns;
+    rec->data_len    = data_len;
+    rec->reserved    = 0;
+    if (data_len)
+        memcpy(rec + 1, data, data_len);
+
+    // Publish
+    m_hdr->records++;
+    m_hdr->head = head + size;
+}
+//-------------------------------------------------------------
+// next_record: Iterate a mapped trace
+//-------------------------------------------------------------
+const tTraceRecord *ftdi_trace::next_record(const tTraceHeader *hdr, uint64_t &pos)
+{
+    const uint8_t *base = (const uint8_t *)hdr + hdr->header_size;
+
+    while (pos < hdr->head)
+    {
+        uint64_t room = hdr->capacity - (pos % hdr->capacity);
+        if (room < sizeof(tTraceRecord))
+        {
+            pos += room;
+            continue;
+        }
+
+        const tTraceRecord *rec = (const tTraceRecord *)(base + (pos % hdr->capacity));
+        pos += sizeof(tTraceRecord) + TRACE_ALIGN(rec->data_len);
+        if (rec->type != TRACE_REC_PAD)
+            return rec;
+    }
+
+    return NULL;
+}
+//-------------------------------------------------------------
+// ftdi_driver_api: Pass through and record
+//-------------------------------------------------------------
+bool ftdi_trace::open(int device_idx)
+{
+    return m_port->open(device_idx);
+}
+void ftdi_trace::close(void)
+{
+    m_port->close();
+}
+int ftdi_trace::read(uint8_t *data, int length, int timeout_ms)
+{
+    uint64_t t0 = m_hdr ? now_ns() : 0;
+    int res = m_port->read(data, length, timeout_ms);
+    record(TRACE_REC_READ, length, timeout_ms, res, t0, data, res);
+    return res;
+}
+int ftdi_trace::write(uint8_t *data, int length, int timeout_ms)
+{
+    uint64_t t0 = m_hdr ? now_ns() : 0;
+    int res = m_port->write(data, length, timeout_ms);
+    record(TRACE_REC_WRITE, length, timeout_ms, res, t0, data, length);
+    return res;
+}
+void ftdi_trace::sleep(int wait_us)
+{
+    uint64_t t0 = m_hdr ? now_ns() : 0;
+    m_port->sleep(wait_us);
+    record(TRACE_REC_SLEEP, wait_us, 0, 0, t0, NULL, 0);
+}
+bool ftdi_trace::set_read_stream(int size)
+{
+    uint64_t t0 = m_hdr ? now_ns() : 0;
+    bool ok = m_port->set_read_stream(size);
+    record(TRACE_REC_STREAM, size, 0, ok ? 1 : 0, t0, NULL, 0);
+    return ok;
+}
@@ -0,0 +1,97 @@
+#ifndef FTDI_TRACE_H
+#define FTDI_TRACE_H
+
+#include <stdint.h>
+
+#include "ftdi_driver_api.h"
+
+//-------------------------------------------------------------
+// Trace file format
+//
+// [tTraceHeader][ring of capacity bytes]
+// Each record is a tTraceRecord followed by data_len bytes of
+// payload, padded to 8 bytes. Records never straddle the end of
+// the ring: a TRACE_REC_PAD record (or, if there is no room for a
+// record header, the end of the ring itself) marks the wrap. Once
+// full, the oldest records are overwritten.
+//-------------------------------------------------------------
+#define TRACE_MAGIC             0x52544654  // "FTTR"
+#define TRACE_VERSION           1
+#define TRACE_DEFAULT_SIZE      (64 * 1024 * 1024)
+
+#define TRACE_REC_WRITE         1   // write(): payload = data sent
+#define TRACE_REC_READ          2   // read(): payload = data received
+#define TRACE_REC_STREAM        3   // set_read_stream(length)
+#define TRACE_REC_SLEEP         4   // sleep(length us)
+#define TRACE_REC_PAD           0xFF
+
+#define TRACE_FLAG_TRUNCATED    0x01    // Payload not stored (too large)
+
+typedef struct TraceHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint64_t capacity;      // Ring bytes
+    uint64_t head;          // Ring offset written so far (monotonic)
+    uint64_t tail;          // Oldest record (monotonic)
+    uint64_t start_time;    // Wall clock at start (seconds since epoch)
+    uint64_t records;       // Records in the ring
+    uint64_t dropped;       // Records overwritten
+} tTraceHeader;
+
+typedef struct TraceRecord
+{
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t timeout_ms;    // As passed (saturates)
+    uint32_t length;        // Bytes asked for / stream size / sleep us
+    int32_t  result;        // Returned count
+    uint32_t duration_ns;   // Saturates at ~4.3s
+    uint64_t time_ns;       // Call start, relative to trace start
+    uint32_t data_len;      // Payload bytes stored
+    uint32_t reserved;
+} tTraceRecord;
+
+//-------------------------------------------------------------
+// ftdi_trace: Recording wrapper around another transport.
+// Every call is passed through and logged to a memory mapped
+// ring buffer file (see replay for the other half).
+//-------------------------------------------------------------
+class ftdi_trace: public ftdi_driver_api
+{
+public:
+    ftdi_trace(ftdi_driver_api *port);
+    ~ftdi_trace();
+
+    // Create the trace file (capacity rounded to 8 bytes)
+    bool start(const char *filename, uint64_t capacity = TRACE_DEFAULT_SIZE);
+    void stop(void);
+
+    bool open(int device_idx);
+    void close(void);
+    int  read(uint8_t *data, int length, int timeout_ms);
+    int  write(uint8_t *data, int length, int timeout_ms);
+    void sleep(int wait_us);
+    bool set_read_stream(int size);
+
+    // Walk records oldest first in a mapped trace: start with
+    // pos = hdr->tail, returns NULL after the newest record.
+    static const tTraceRecord *next_record(const tTraceHeader *hdr, uint64_t &pos);
+
+protected:
+    void     record(uint8_t type, uint32_t length, int timeout_ms, int32_t result, uint64_t start_ns, const uint8_t *data, int data_len);
+    void     drop_oldest(void);
+    uint64_t now_ns(void);
+    uint8_t *ring(uint64_t offset) { return m_ring + (offset % m_hdr->capacity); }
+
+    ftdi_driver_api *m_port;
+    int              m_fd;
+    uint8_t         *m_map;
+    uint64_t         m_map_size;
+    tTraceHeader    *m_hdr;
+    uint8_t         *m_ring;
+    uint64_t         m_start_ns;
+};
+
+#endif
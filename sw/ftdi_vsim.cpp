@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "verilated.h"
+#if VM_TRACE
+#include "verilated_vcd_c.h"
+#endif
+#include "Vft60x_axi.h"
+
+#include "ftdi_vsim.h"
+
+//-------------------------------------------------------------
+// Constructor
+//-------------------------------------------------------------
+ftdi_vsim::ftdi_vsim()
+{
+    m_ctx         = NULL;
+    m_top         = NULL;
+    m_trace       = NULL;
+    m_out_pos     = 0;
+    m_in_pos      = 0;
+    m_buf_bytes   = VSIM_DEFAULT_BUF_BYTES;
+    m_axi_latency = 0;
+    m_gpio_in     = 0;
+    m_cycle       = 0;
+    m_idle        = 0;
+
+    reset_stats();
+}
+//-------------------------------------------------------------
+// Destructor
+//-------------------------------------------------------------
+ftdi_vsim::~ftdi_vsim()
+{
+    close();
+
+    for (std::map<uint32_t, uint8_t*>::iterator it = m_pages.begin(); it != m_pages.end(); ++it)
+        free(it->second);
+}
+//-------------------------------------------------------------
+// open: Build the model and hold it in reset for a few clocks
+//-------------------------------------------------------------
+bool ftdi_vsim::open(int device_idx)
+{
+    if (m_top)
+        return true;
+
+    const char *s = getenv("FTDI_VSIM_AXI_LATENCY");
+    if (s)
+        m_axi_latency = strtoul(s, NULL, 0);
+
+    m_ctx = new VerilatedContext;
+#if VM_TRACE
+    const char *trace_file = getenv("FTDI_VSIM_TRACE");
+    if (trace_file)
+        m_ctx->traceEverOn(true);
+#endif
+    m_top = new Vft60x_axi(m_ctx);
+#if VM_TRACE
+    if (trace_file)
+    {
+        m_trace = new VerilatedVcdC;
+        m_top->trace(m_trace, 99);
+        m_trace->open(trace_file);
+    }
+#endif
+
+    m_out.clear();
+    m_out_pos = 0;
+    m_in.clear();
+    m_in_pos  = 0;
+    m_aw.clear();
+    m_b.clear();
+    m_ar.clear();
+    m_cycle   = 0;
+
+    // Bus idle: FT601 FIFOs empty / full (active low flags)
+    m_top->ftdi_rxf_i = 1;
+    m_top->ftdi_txe_i = 1;
+    m_top->clk_i      = 0;
+    m_top->rst_i      = 1;
+    for (int i=0;i<8;i++)
+    {
+        m_top->clk_i = 1;
+        m_top->eval();
+        m_top->clk_i = 0;
+        m_top->eval();
+    }
+    m_top->rst_i = 0;
+    m_top->eval();
+
+    reset_stats();
+    return true;
+}
+//-------------------------------------------------------------
+// close: Finish and release the model
+//-------------------------------------------------------------
+void ftdi_vsim::close(void)
+{
+    if (!m_top)
+        return;
+
+    m_top->final();
+#if VM_TRACE
+    if (m_trace)
+    {
+        m_trace->close();
+        delete m_trace;
+    }
+#endif
+    m_trace = NULL;
+
+    delete m_top;
+    m_top = NULL;
+    delete m_ctx;
+    m_ctx = NULL;
+}
+//-------------------------------------------------------------
+// idle_limit: Cycles without bus or AXI activity after which
+// nothing more can happen without the host
+//-------------------------------------------------------------
+uint64_t ftdi_vsim::idle_limit(void)
+{
+    return VSIM_IDLE_CYCLES + (2 * (uint64_t)m_axi_latency);
+}
+//-------------------------------------------------------------
+// step: Drive the FT601 and AXI slave models for one clock.
+// Handshakes are sampled before the rising edge and applied to
+// the models after it. Returns true if anything moved.
+//-------------------------------------------------------------
+bool ftdi_vsim::step(void)
+{
+    Vft60x_axi *t = m_top;
+
+    // FT601: RXF_N low while OUT data is pending, TXE_N low while
+    // the IN buffer can take another word.
+    bool out_avail    = m_out_pos < (int)m_out.size();
+    t->ftdi_rxf_i     = !out_avail;
+    t->ftdi_data_in_i = out_avail ? m_out[m_out_pos] : 0;
+    t->ftdi_be_in_i   = 0xF;
+    t->ftdi_txe_i     = (in_level() + 4) > m_buf_bytes;
+
+    // AXI slave
+    bool bvalid = !m_b.empty() && m_b[0].ready <= m_cycle;
+    bool rvalid = !m_ar.empty() && m_ar[0].ready <= m_cycle;
+
+    t->outport_awready_i = m_aw.size() < VSIM_AXI_OUTSTANDING;
+    t->outport_wready_i  = !m_aw.empty();
+    t->outport_bvalid_i  = bvalid;
+    t->outport_bresp_i   = 0;
+    t->outport_bid_i     = bvalid ? m_b[0].id : 0;
+    t->outport_arready_i = m_ar.size() < VSIM_AXI_OUTSTANDING;
+    t->outport_rvalid_i  = rvalid;
+    t->outport_rdata_i   = rvalid ? mem_read32(m_ar[0].addr + (m_ar[0].beat * 4)) : 0;
+    t->outport_rresp_i   = 0;
+    t->outport_rid_i     = rvalid ? m_ar[0].id : 0;
+    t->outport_rlast_i   = rvalid && (m_ar[0].beat == m_ar[0].len);
+    t->gpio_inputs_i     = m_gpio_in;
+    t->eval();
+
+    // Sample handshakes
+    bool rd = out_avail && !t->ftdi_oen_o && !t->ftdi_rdn_o;
+    bool wr = !t->ftdi_txe_i && !t->ftdi_wrn_o;
+    bool aw = t->outport_awvalid_o && t->outport_awready_i;
+    bool w  = t->outport_wvalid_o && t->outport_wready_i;
+    bool b  = bvalid && t->outport_bready_o;
+    bool ar = t->outport_arvalid_o && t->outport_arready_i;
+    bool r  = rvalid && t->outport_rready_o;
+
+    uint32_t wr_data = t->ftdi_data_out_o;
+    uint8_t  wr_be   = t->ftdi_be_out_o;
+
+    tVsimBurst aw_req;
+    aw_req.addr  = t->outport_awaddr_o & ~3;
+    aw_req.len   = t->outport_awlen_o;
+    aw_req.beat  = 0;
+    aw_req.id    = t->outport_awid_o;
+    aw_req.ready = 0;
+
+    tVsimBurst ar_req;
+    ar_req.addr  = t->outport_araddr_o & ~3;
+    ar_req.len   = t->outport_arlen_o;
+    ar_req.beat  = 0;
+    ar_req.id    = t->outport_arid_o;
+    ar_req.ready = m_cycle + 1 + m_axi_latency;
+
+    uint32_t w_data = t->outport_wdata_o;
+    uint8_t  w_strb = t->outport_wstrb_o;
+    bool     w_last = t->outport_wlast_o;
+
+    m_stats.rd_cycles += !t->ftdi_rdn_o;
+    m_stats.wr_cycles += !t->ftdi_wrn_o;
+
+    // Rising edge
+    t->clk_i = 1;
+    t->eval();
+#if VM_TRACE
+    if (m_trace)
+        m_trace->dump(m_cycle * 10);
+#endif
+    t->clk_i = 0;
+    t->eval();
+#if VM_TRACE
+    if (m_trace)
+        m_trace->dump((m_cycle * 10) + 5);
+#endif
+    m_cycle++;
+    m_stats.cycles++;
+
+    // Apply to the FT601 model
+    if (rd)
+    {
+        m_out_pos++;
+        m_stats.rx_words++;
+    }
+    if (wr)
+    {
+        for (int i=0;i<4;i++)
+            if (wr_be & (1 << i))
+                m_in.push_back(wr_data >> (8 * i));
+        m_stats.tx_words++;
+    }
+
+    // Apply to the AXI slave (W before AW: wready needed an AW)
+    if (w)
+    {
+        tVsimBurst &burst = m_aw[0];
+        mem_write32(burst.addr + (burst.beat * 4), w_data, w_strb);
+        burst.beat++;
+        m_stats.axi_w_beats++;
+
+        if (w_last)
+        {
+            burst.ready = m_cycle + m_axi_latency;
+            m_b.push_back(burst);
+            m_aw.erase(m_aw.begin());
+        }
+    }
+    if (aw)
+    {
+        m_aw.push_back(aw_req);
+        m_stats.axi_aw++;
+    }
+    if (b)
+        m_b.erase(m_b.begin());
+    if (r)
+    {
+        m_stats.axi_r_beats++;
+        if (m_ar[0].beat++ == m_ar[0].len)
+            m_ar.erase(m_ar.begin());
+    }
+    if (ar)
+    {
+        m_ar.push_back(ar_req);
+        m_stats.axi_ar++;
+    }
+
+    // Reclaim consumed OUT words
+    if (m_out_pos == (int)m_out.size())
+    {
+        m_out.clear();
+        m_out_pos = 0;
+    }
+
+    bool active = rd || wr || aw || w || b || ar || r;
+    m_idle = active ? 0 : (m_idle + 1);
+    return active;
+}
+//-------------------------------------------------------------
+// write: Queue host data on the FT601 OUT side, clocking the
+// target while more than the device buffering is outstanding.
+// The timeout is replaced by idle detection in simulated time.
+//-------------------------------------------------------------
+int ftdi_vsim::write(uint8_t *data, int length, int timeout_ms)
+{
+    if (!m_top)
+        return -1;
+
+    for (int i=0;i<length;i+=4)
+    {
+        uint32_t word = 0;
+        for (int j=0;j<4 && (i+j)<length;j++)
+            word |= (uint32_t)data[i+j] << (8 * j);
+        m_out.push_back(word);
+    }
+
+    m_idle = 0;
+    while (((int)m_out.size() - m_out_pos) * 4 > m_buf_bytes)
+    {
+        step();
+
+        if (m_idle > idle_limit())
+        {
+            // Withdraw what the target never took
+            int excess = ((int)m_out.size() - m_out_pos) - (m_buf_bytes / 4);
+            m_out.resize(m_out.size() - excess);
+
+            int accepted = length - (excess * 4);
+            if (accepted < 0)
+                accepted = 0;
+
+            fprintf(stderr, "VSIM: Write stalled, target not reading (%d/%d bytes)\n", accepted, length);
+            return accepted;
+        }
+    }
+
+    return length;
+}
+//-------------------------------------------------------------
+// read: Clock the target until enough IN data has arrived or
+// it goes idle, then return what is available.
+//-------------------------------------------------------------
+int ftdi_vsim::read(uint8_t *data, int length, int timeout_ms)
+{
+    if (!m_top)
+        return -1;
+
+    m_idle = 0;
+    while (in_level() < length && m_idle <= idle_limit())
+        step();
+
+    int avail = in_level();
+    if (length > avail)
+        length = avail;
+
+    memcpy(data, &m_in[m_in_pos], length);
+    m_in_pos += length;
+
+    if (m_in_pos == (int)m_in.size())
+    {
+        m_in.clear();
+        m_in_pos = 0;
+    }
+
+    return length;
+}
+//-------------------------------------------------------------
+// sleep: Advance simulated time (stops early once idle)
+//-------------------------------------------------------------
+void ftdi_vsim::sleep(int wait_us)
+{
+    if (!m_top)
+        return;
+
+    uint64_t cycles = (uint64_t)wait_us * VSIM_CLK_MHZ;
+
+    m_idle = 0;
+    for (uint64_t i=0;i<cycles && m_idle <= idle_limit();i++)
+        step();
+}
+//-------------------------------------------------------------
+// get_gpio_outputs: Current value of gpio_outputs_o
+//-------------------------------------------------------------
+uint32_t ftdi_vsim::get_gpio_outputs(void)
+{
+    return m_top ? m_top->gpio_outputs_o : 0;
+}
+//-------------------------------------------------------------
+// page: Find (optionally allocate) the page holding addr
+//-------------------------------------------------------------
+uint8_t *ftdi_vsim::page(uint32_t addr, bool alloc)
+{
+    uint32_t key = addr & ~(uint32_t)(VSIM_PAGE_SIZE - 1);
+
+    std::map<uint32_t, uint8_t*>::iterator it = m_pages.find(key);
+    if (it != m_pages.end())
+        return it->second;
+    if (!alloc)
+        return NULL;
+
+    uint8_t *p = (uint8_t *)calloc(1, VSIM_PAGE_SIZE);
+    m_pages[key] = p;
+    return p;
+}
+//-------------------------------------------------------------
+// mem_read32 / mem_write32: AXI slave word access
+//-------------------------------------------------------------
+uint32_t ftdi_vsim::mem_read32(uint32_t addr)
+{
+    uint8_t *p = page(addr, false);
+    if (!p)
+        return 0;
+
+    p += addr & (VSIM_PAGE_SIZE - 1);
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+void ftdi_vsim::mem_write32(uint32_t addr, uint32_t data, uint8_t strb)
+{
+    uint8_t *p = page(addr, true) + (addr & (VSIM_PAGE_SIZE - 1));
+    for (int i=0;i<4;i++)
+        if (strb & (1 << i))
+            p[i] = data >> (8 * i);
+}
+//-------------------------------------------------------------
+// mem_write / mem_read: Backdoor access
+//-------------------------------------------------------------
+void ftdi_vsim::mem_write(uint32_t addr, const uint8_t *data, int length)
+{
+    for (int i=0;i<length;i++)
+        page(addr + i, true)[(addr + i) & (VSIM_PAGE_SIZE - 1)] = data[i];
+}
+void ftdi_vsim::mem_read(uint32_t addr, uint8_t *data, int length)
+{
+    for (int i=0;i<length;i++)
+    {
+        uint8_t *p = page(addr + i, false);
+        data[i] = p ? p[(addr + i) & (VSIM_PAGE_SIZE - 1)] : 0;
+    }
+}
+//-------------------------------------------------------------
+// Statistics
+//-------------------------------------------------------------
+void ftdi_vsim::reset_stats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+void ftdi_vsim::print_stats(FILE *f)
+{
+    tVsimStats &s = m_stats;
+    double cycles = s.cycles ? (double)s.cycles : 1.0;
+    double ft_bytes  = (s.rx_words + s.tx_words) * 4.0;
+    double axi_bytes = (s.axi_w_beats + s.axi_r_beats) * 4.0;
+
+    fprintf(f, "VSIM: %llu cycles (%.3f ms @ %dMHz)\n",
+            (unsigned long long)s.cycles, s.cycles / (VSIM_CLK_MHZ * 1000.0), VSIM_CLK_MHZ);
+    fprintf(f, "VSIM: FT bus %llu words out, %llu words in; RD_N %.1f%%, WR_N %.1f%%, idle/turnaround %.1f%%\n",
+            (unsigned long long)s.rx_words, (unsigned long long)s.tx_words,
+            (s.rd_cycles * 100.0) / cycles, (s.wr_cycles * 100.0) / cycles,
+            ((s.cycles - s.rd_cycles - s.wr_cycles) * 100.0) / cycles);
+    fprintf(f, "VSIM: AXI %llu AW / %llu W beats, %llu AR / %llu R beats (latency %d)\n",
+            (unsigned long long)s.axi_aw, (unsigned long long)s.axi_w_beats,
+            (unsigned long long)s.axi_ar, (unsigned long long)s.axi_r_beats, m_axi_latency);
+    if (ft_bytes > 0 && axi_bytes > 0)
+        fprintf(f, "VSIM: %.3f clocks/byte on the FT bus, %.3f clocks/byte of AXI data (%.1f MB/s)\n",
+                s.cycles / ft_bytes, s.cycles / axi_bytes, (axi_bytes * VSIM_CLK_MHZ) / cycles);
+}
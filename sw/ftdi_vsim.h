@@ -0,0 +1,121 @@
+#ifndef FTDI_VSIM_H
+#define FTDI_VSIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "ftdi_driver_api.h"
+
+class Vft60x_axi;
+class VerilatedContext;
+class VerilatedVcdC;
+
+//-------------------------------------------------------------
+// Defaults
+//-------------------------------------------------------------
+#define VSIM_CLK_MHZ            100         // FT601 CLK in 245 mode
+#define VSIM_DEFAULT_BUF_BYTES  (16 * 1024) // FT601 per-direction buffering
+#define VSIM_IDLE_CYCLES        1024        // > ft60x_fifo TX_BACKOFF_THRESH
+#define VSIM_AXI_OUTSTANDING    4
+#define VSIM_PAGE_SIZE          (64 * 1024)
+
+//-------------------------------------------------------------
+// tVsimStats: Cycle accounting since open() / reset_stats()
+//-------------------------------------------------------------
+typedef struct VsimStats
+{
+    uint64_t cycles;
+    uint64_t rx_words;      // Host -> target words on the FT bus
+    uint64_t tx_words;      // Target -> host words on the FT bus
+    uint64_t rd_cycles;     // RD_N asserted
+    uint64_t wr_cycles;     // WR_N asserted
+    uint64_t axi_aw;
+    uint64_t axi_ar;
+    uint64_t axi_w_beats;
+    uint64_t axi_r_beats;
+} tVsimStats;
+
+//-------------------------------------------------------------
+// ftdi_vsim: Verilator co-simulation of src_v/ft60x_axi.
+//
+// Clocks the real RTL against a model of the FT601 245-mode FIFO
+// bus (RXF_N/TXE_N/RD_N/WR_N/OE_N) on one side and an AXI4 memory
+// slave with a fixed response latency on the other. The clock only
+// runs inside read/write/sleep, so host time does not matter; the
+// statistics report what the target actually spent per byte.
+//
+// Environment (read by open):
+//   FTDI_VSIM_AXI_LATENCY  AXI read/write response latency (cycles)
+//   FTDI_VSIM_TRACE        VCD file name (needs 'verilator --trace')
+//-------------------------------------------------------------
+class ftdi_vsim: public ftdi_driver_api
+{
+public:
+    ftdi_vsim();
+    ~ftdi_vsim();
+
+    bool open(int device_idx);
+    void close(void);
+    int  read(uint8_t *data, int length, int timeout_ms);
+    int  write(uint8_t *data, int length, int timeout_ms);
+    void sleep(int wait_us);
+
+    // Model configuration (before open)
+    void set_axi_latency(int cycles)   { m_axi_latency = cycles; }
+    void set_buffer_size(int bytes)    { m_buf_bytes = bytes; }
+
+    // Backdoor memory / GPIO access
+    void     mem_write(uint32_t addr, const uint8_t *data, int length);
+    void     mem_read(uint32_t addr, uint8_t *data, int length);
+    void     set_gpio_inputs(uint32_t value) { m_gpio_in = value; }
+    uint32_t get_gpio_outputs(void);
+
+    // Statistics
+    void       reset_stats(void);
+    tVsimStats get_stats(void) { return m_stats; }
+    void       print_stats(FILE *f);
+
+protected:
+    typedef struct VsimBurst
+    {
+        uint32_t addr;
+        int      len;       // AXI len (beats - 1)
+        int      beat;
+        uint8_t  id;
+        uint64_t ready;     // Cycle the slave may respond
+    } tVsimBurst;
+
+    bool     step(void);
+    uint64_t idle_limit(void);
+    uint8_t *page(uint32_t addr, bool alloc);
+    uint32_t mem_read32(uint32_t addr);
+    void     mem_write32(uint32_t addr, uint32_t data, uint8_t strb);
+    int      in_level(void) { return (int)m_in.size() - m_in_pos; }
+
+    VerilatedContext            *m_ctx;
+    Vft60x_axi                  *m_top;
+    VerilatedVcdC               *m_trace;
+
+    // FT601 buffers (OUT: host -> target, IN: target -> host)
+    std::vector<uint32_t>        m_out;
+    int                          m_out_pos;
+    std::vector<uint8_t>         m_in;
+    int                          m_in_pos;
+    int                          m_buf_bytes;
+
+    // AXI slave
+    std::vector<tVsimBurst>      m_aw;
+    std::vector<tVsimBurst>      m_b;
+    std::vector<tVsimBurst>      m_ar;
+    int                          m_axi_latency;
+    std::map<uint32_t, uint8_t*> m_pages;
+
+    uint32_t                     m_gpio_in;
+    uint64_t                     m_cycle;
+    uint64_t                     m_idle;
+    tVsimStats                   m_stats;
+};
+
+#endif
@@ -7,11 +7,16 @@
 
 #include "ftdi_axi_driver.h"
 #include "ftdi_ft60x.h"
+#include "ftdi_trace.h"
+#include "ftdi_read_ahead.h"
+#ifdef FTDI_VSIM
+#include "ftdi_vsim.h"
+#endif
 
 //-----------------------------------------------------------------
 // Command line options
 //-----------------------------------------------------------------
-#define GETOPTS_ARGS "d:a:s:f:h"
+#define GETOPTS_ARGS "d:a:s:f:c:w:q:T:b:h"
 
 static struct option long_options[] =
 {
@@ -19,6 +24,11 @@ static struct option long_options[] =
     {"address",      required_argument, 0, 'a'},
     {"size",         required_argument, 0, 's'},
     {"filename",     required_argument, 0, 'f'},
+    {"config",       required_argument, 0, 'c'},
+    {"queue",        required_argument, 0, 'q'},
+    {"trace",        required_argument, 0, 'T'},
+    {"wait",         required_argument, 0, 'w'},
+    {"chunk",        required_argument, 0, 'b'},
     {"help",         no_argument,       0, 'h'},
     {0, 0, 0, 0}
 };
@@ -30,53 +40,14 @@ static void help_options(void)
     fprintf (stderr,"  --address    | -a ADDR       Address to load file to (default: 0)\n");
     fprintf (stderr,"  --filename   | -f FILENAME   File to load\n");
     fprintf (stderr,"  --size       | -s SIZE       File size (default: actual file size)\n");
+    fprintf (stderr,"  --config     | -c FILENAME   Driver settings file (see tune)\n");
+    fprintf (stderr,"  --queue      | -q DEPTH      Overlapped USB transfers per direction (default: 0)\n");
+    fprintf (stderr,"  --trace      | -T FILENAME   Record USB traffic to a trace file (see replay)\n");
+    fprintf (stderr,"  --wait       | -w MODE       Write completion wait: spin, adaptive, none (default: adaptive)\n");
+    fprintf (stderr,"  --chunk      | -b BYTES      Read-ahead chunk size (default: 4MB, %d in flight)\n", READ_AHEAD_BUFFERS);
     exit(-1);
 }
 //-----------------------------------------------------------------
-// load_file_to_mem
-//-----------------------------------------------------------------
-static uint8_t* load_file_to_mem(const char *filename, long size_override, int *pSize)
-{
-    uint8_t *buf = NULL;
-    FILE *f = fopen(filename, "rb");
-
-    *pSize = 0;
-
-    if (f)
-    {
-        long size;
-
-        // Get size of file
-        fseek(f, 0, SEEK_END);
-        size = ftell(f);
-        rewind(f);
-
-        // User overriden file size
-        if (size_override >= 0)
-        {
-            if (size > size_override)
-                size = size_override;
-        }
-
-        buf = new uint8_t[size];
-        if (buf)
-        {
-            // Read file data into allocated memory
-            int len = fread(buf, 1, size, f);
-            if (len != size)
-            {
-                delete[] buf;
-                buf = NULL;
-            }
-            else
-                *pSize = size;
-        }
-        fclose(f);
-    }
-
-    return buf;
-}
-//-----------------------------------------------------------------
 // main:
 //-----------------------------------------------------------------
 int main(int argc, char *argv[])
@@ -85,8 +56,13 @@ int main(int argc, char *argv[])
     int      help      = 0;
     int      device    = 0;
     uint32_t addr      = 0;
-    long     size_override = -1;
+    int64_t  size_override = -1;
+    int      chunk    = READ_AHEAD_DEFAULT_CHUNK;
     char *   filename = NULL;
+    char *   config   = NULL;
+    char *   trace_file = NULL;
+    int      queue    = 0;
+    int      wait_mode = FT60X_WAIT_ADAPTIVE;
 
     int option_index = 0;
     while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
@@ -103,7 +79,29 @@ int main(int argc, char *argv[])
                  filename = optarg;
                  break;
             case 's':
-                 size_override = strtol(optarg, NULL, 0);
+                 size_override = strtoll(optarg, NULL, 0);
+                 break;
+            case 'c':
+                 config = optarg;
+                 break;
+            case 'q':
+                 queue = strtoul(optarg, NULL, 0);
+                 break;
+            case 'T':
+                 trace_file = optarg;
+                 break;
+            case 'b':
+                 chunk = strtoul(optarg, NULL, 0);
+                 break;
+            case 'w':
+                 if (!strcmp(optarg, "spin"))
+                     wait_mode = FT60X_WAIT_SPIN;
+                 else if (!strcmp(optarg, "adaptive"))
+                     wait_mode = FT60X_WAIT_ADAPTIVE;
+                 else if (!strcmp(optarg, "none"))
+                     wait_mode = FT60X_WAIT_NONE;
+                 else
+                     help = 1;
                  break;
             default:
                 help = 1;
@@ -111,48 +109,129 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (help || filename == NULL)
+    if (help || filename == NULL || chunk <= 0)
     {
         help_options();
         return -1;
     }
 
     // Open the port
+#ifdef FTDI_VSIM
+    ftdi_vsim port;
+#else
     ftdi_ft60x port;
+    port.set_overlapped(queue);
+#endif
     if (!port.open(0))
         return -1;
+#ifndef FTDI_VSIM
+    port.set_write_wait(wait_mode);
+#endif
+
+    // Optionally record everything crossing the port
+    ftdi_trace trace(&port);
+    ftdi_driver_api *link = &port;
+    if (trace_file)
+    {
+        if (!trace.start(trace_file))
+        {
+            port.close();
+            return -1;
+        }
+        link = &trace;
+    }
 
     // Reset target state machines
-    ftdi_axi_driver driver(&port);
+    ftdi_axi_driver driver(link);
+    if (config && !driver.load_settings(config))
+    {
+        fprintf (stderr,"Error: Could not load settings from %s\n", config);
+        port.close();
+        return -1;
+    }
     driver.send_drain(1000);
-    port.sleep(10000);
+    link->sleep(10000);
 
-    // Read file into memory
-    bool ok = true;
-    int size = 0;
-    uint8_t *buf = load_file_to_mem(filename, size_override, &size);
-    if (buf)
+    // Stream the file: disk reads run ahead of the USB writes
+    ftdi_read_ahead file;
+    if (!file.open(filename, size_override, chunk))
     {
-        printf("Loading %s (%dKB) to 0x%x...\n", filename, (size + 1023) / 1024, addr);
+        fprintf (stderr,"Error: Could not open file\n");
+        port.close();
+        return -1;
+    }
 
-        // Upload file to target
-        ok = driver.write(addr, buf, size);
+    uint64_t size = file.size();
+    if ((addr + size) > 0x100000000ULL)
+    {
+        fprintf (stderr,"Error: %llu bytes at 0x%x exceed the 32-bit address space\n", (unsigned long long)size, addr);
+        file.close();
+        port.close();
+        return -1;
+    }
+
+    printf("Loading %s (%lluKB) to 0x%x...\n", filename, (unsigned long long)(size + 1023) / 1024, addr);
 
-        // Free file memory
-        delete[] buf;
-        buf = NULL;
+    // Upload file to target
+#ifdef FTDI_VSIM
+    port.reset_stats();
+#else
+    port.reset_write_stats();
+#endif
+    double t1   = ftdi_time_now();
+    double cpu1 = ftdi_cpu_now();
 
-        if (ok)
-            printf("Done!\n");
-        else
-            printf("Failed!\n");
+    bool     ok         = true;
+    uint64_t done       = 0;
+    double   last_print = t1;
+
+    while (ok && done < size)
+    {
+        uint8_t *data;
+        int      length = file.next(data);
+        if (length < 0)
+        {
+            fprintf (stderr,"\nError: Could not read file at offset %llu\n", (unsigned long long)done);
+            ok = false;
+            break;
+        }
+
+        ok = driver.write(addr + (uint32_t)done, data, length);
+        done += length;
+        file.release();
+
+        double now = ftdi_time_now();
+        if ((now - last_print) >= 0.5 || done == size)
+        {
+            ftdi_print_progress(done, size, now - t1);
+            last_print = now;
+        }
     }
-    else
+
+    double disk_wait = file.get_wait_time();
+    file.close();
+
+    double t2   = ftdi_time_now();
+    double cpu2 = ftdi_cpu_now();
+    if (done)
+        printf("\n");
+
+    if (ok && size > 0)
     {
-        fprintf (stderr,"Error: Could not open file\n");
-        ok = false;
+        double mb = size / (1024.0 * 1024.0);
+#ifdef FTDI_VSIM
+        port.print_stats(stdout);
+#else
+        printf("%.2f MB/s, CPU %.1f ms/MB (completion wait %.1f ms/MB), waited %.1f ms on disk\n",
+               mb / (t2 - t1), ((cpu2 - cpu1) * 1000.0) / mb, port.get_write_cpu_per_mb(), disk_wait * 1000.0);
+#endif
     }
 
+    if (ok)
+        printf("Done!\n");
+    else
+        printf("Failed!\n");
+
     port.close();
     return ok ? 0: -1;
 }
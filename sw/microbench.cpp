@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+#include <new>
+#include <atomic>
+#include <sys/time.h>
+#include <thread>
+
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_async.h"
+#include "ftdi_axi_coro.h"
+#include "ftdi_axi_protocol.h"
+#include "ftdi_emu.h"
+
+//-----------------------------------------------------------------
+// Allocation counting
+//-----------------------------------------------------------------
+static std::atomic<long> g_allocs(0);
+
+void* operator new(size_t size)
+{
+    g_allocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size)
+{
+    g_allocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) throw() { free(p); }
+void operator delete[](void *p) throw() { free(p); }
+void operator delete(void *p, size_t) throw() { free(p); }
+void operator delete[](void *p, size_t) throw() { free(p); }
+
+//-----------------------------------------------------------------
+// Benchmark helpers
+//-----------------------------------------------------------------
+static double time_now(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + (t.tv_usec / 1000000.0);
+}
+
+#define BENCH(_name, _iters, _op) do { \
+        long   allocs = g_allocs; \
+        double t1     = time_now(); \
+        for (int i=0;i<(_iters);i++) \
+            if (!(_op)) { fprintf(stderr, "ERROR: %s failed\n", _name); return -1; } \
+        double t2     = time_now(); \
+        allocs = g_allocs - allocs; \
+        printf("%-16s %12.0f ops/s  %6.3f allocs/op\n", _name, (_iters) / (t2 - t1), (double)allocs / (_iters)); \
+    } while (0)
+
+//-----------------------------------------------------------------
+// staged_write: Produce a block directly into the staging buffer
+//-----------------------------------------------------------------
+static bool staged_write(ftdi_axi_driver &driver, uint32_t addr, int length, uint8_t value)
+{
+    tAxiSpan spans[64];
+    while (length)
+    {
+        int num_spans;
+        int reserved = driver.write_reserve(addr, length, spans, 64, num_spans);
+        if (reserved <= 0)
+            return false;
+
+        for (int i=0;i<num_spans;i++)
+            memset(spans[i].data, value, spans[i].length);
+
+        addr   += reserved;
+        length -= reserved;
+    }
+    return driver.write_commit();
+}
+//-----------------------------------------------------------------
+// viewed_read: Consume a block in place (two views in flight)
+//-----------------------------------------------------------------
+static uint32_t g_checksum;
+
+static bool viewed_read(ftdi_axi_driver &driver, uint32_t addr, int length)
+{
+    static tAxiReadView views[2];
+    int submitted = 0;
+    int completed = 0;
+
+    while (length > 0 || completed < submitted)
+    {
+        if (length > 0 && (submitted - completed) < 2)
+        {
+            int n = driver.read_view_submit(addr, length, views[submitted % 2]);
+            if (n <= 0)
+                return false;
+            addr   += n;
+            length -= n;
+            submitted++;
+        }
+        else
+        {
+            tAxiReadView &view = views[completed % 2];
+            if (!driver.read_view_wait(view))
+                return false;
+            for (int i=0;i<view.count;i++)
+                for (int j=0;j<view.spans[i].length;j+=64)
+                    g_checksum += view.spans[i].data[j];
+            driver.read_view_release(view);
+            completed++;
+        }
+    }
+    return true;
+}
+//-----------------------------------------------------------------
+// async_worker: Keep a window of reads in flight on the async engine
+//-----------------------------------------------------------------
+#define ASYNC_WINDOW    16
+
+static void async_worker(ftdi_axi_async *engine, int iters)
+{
+    uint32_t          values[ASYNC_WINDOW];
+    std::future<bool> done[ASYNC_WINDOW];
+
+    for (int i=0;i<iters;i+=ASYNC_WINDOW)
+    {
+        for (int j=0;j<ASYNC_WINDOW;j++)
+            done[j] = engine->read32(0x1000 + (j * 4), &values[j]);
+        for (int j=0;j<ASYNC_WINDOW;j++)
+            if (!done[j].get())
+                fprintf(stderr, "ERROR: async read32 failed\n");
+    }
+}
+//-----------------------------------------------------------------
+// bench_async: Multiple submitting threads sharing one engine
+//-----------------------------------------------------------------
+static void bench_async(ftdi_driver_api *port, int iters, int threads)
+{
+    ftdi_axi_async engine(port);
+    engine.start();
+
+    std::thread *workers[16];
+    double t1 = time_now();
+    for (int i=0;i<threads;i++)
+        workers[i] = new std::thread(async_worker, &engine, iters / threads);
+    for (int i=0;i<threads;i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+    double t2 = time_now();
+    engine.stop();
+
+    printf("async_read32_x%-2d %12.0f ops/s  %6.1f ops/transfer\n", threads,
+           engine.get_ops() / (t2 - t1), (double)engine.get_ops() / engine.get_transfers());
+}
+//-----------------------------------------------------------------
+// poll_task: Register poll loop as a coroutine
+//-----------------------------------------------------------------
+static ftdi_axi_task poll_task(ftdi_axi_loop &loop, uint32_t addr, int iters)
+{
+    for (int i=0;i<iters;i++)
+    {
+        tAxiResult r = co_await loop.read32(addr);
+        if (!r.ok)
+            co_return;
+    }
+}
+//-----------------------------------------------------------------
+// bench_coro: Many logically concurrent poll loops, one thread
+//-----------------------------------------------------------------
+static void bench_coro(ftdi_driver_api *port, int iters, int tasks)
+{
+    ftdi_axi_loop loop(port);
+
+    for (int i=0;i<tasks;i++)
+        loop.spawn(poll_task(loop, 0x1000 + (i * 4), iters / tasks));
+
+    double t1 = time_now();
+    bool ok = loop.run();
+    double t2 = time_now();
+
+    printf("coro_read32_x%-3d %12.0f ops/s  %6.1f ops/transfer%s\n", tasks,
+           loop.get_ops() / (t2 - t1), (double)loop.get_ops() / loop.get_transfers(), ok ? "" : " (FAILED)");
+}
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "n:b:l:f:h"
+
+static struct option long_options[] =
+{
+    {"iterations", required_argument, 0, 'n'},
+    {"bandwidth",  required_argument, 0, 'b'},
+    {"latency",    required_argument, 0, 'l'},
+    {"fifo",       required_argument, 0, 'f'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --iterations | -n NUM        Iterations per operation (default: 1000000)\n");
+    fprintf (stderr,"  --bandwidth  | -b MBPS       Emulated link bandwidth per direction (default: unlimited)\n");
+    fprintf (stderr,"  --latency    | -l US         Emulated latency per USB transfer (default: 0)\n");
+    fprintf (stderr,"  --fifo       | -f WORDS      Emulated target FIFO depth (default: 2048)\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help  = 0;
+    int iters = 1000000;
+    int bandwidth  = 0;
+    int latency_us = 0;
+    int fifo_words = EMU_DEFAULT_FIFO_WORDS;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 'n':
+                 iters = strtoul(optarg, NULL, 0);
+                 break;
+            case 'b':
+                 bandwidth = strtoul(optarg, NULL, 0);
+                 break;
+            case 'l':
+                 latency_us = strtoul(optarg, NULL, 0);
+                 break;
+            case 'f':
+                 fifo_words = strtoul(optarg, NULL, 0);
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (help || iters <= 0)
+    {
+        help_options();
+        return -1;
+    }
+
+    ftdi_emu *port = new ftdi_emu();
+    port->set_bandwidth(bandwidth);
+    port->set_latency(latency_us);
+    port->set_fifo_depth(fifo_words);
+
+    ftdi_axi_driver driver(port);
+
+    uint32_t value;
+    uint8_t  echo_buf[64];
+    static uint8_t block_buf[4096];
+    static uint8_t large_buf[256 * 1024];
+    memset(echo_buf, 0, sizeof(echo_buf));
+
+    // 256 x 64 byte scattered regions
+    tAxiSpan spans[256];
+    for (int i=0;i<256;i++)
+    {
+        spans[i].addr   = 0x10000 + (i * 4096);
+        spans[i].data   = &large_buf[i * 64];
+        spans[i].length = 64;
+    }
+
+    printf("Host-side driver overhead (emulated target, %d iterations):\n", iters);
+    BENCH("read32",        iters,      driver.read32(0x1000, value));
+    BENCH("write32",       iters,      driver.write32(0x1000, value));
+    BENCH("write32_posted",iters,      driver.write32(0x1000, value, 100, true));
+    BENCH("write8",        iters,      driver.write8(0x1001, 0x55));
+    BENCH("gpio_read",     iters,      driver.gpio_read(value));
+    BENCH("gpio_write",    iters,      driver.gpio_write(value));
+    BENCH("echo_64",       iters,      driver.send_echo(echo_buf, sizeof(echo_buf)));
+    BENCH("write_4k",      iters / 16, driver.write(0x1000, block_buf, sizeof(block_buf)));
+    BENCH("read_4k",       iters / 16, driver.read(0x1000, block_buf, sizeof(block_buf)));
+    BENCH("write_256k",    iters / 1024, driver.write(0x1000, large_buf, sizeof(large_buf)));
+    BENCH("staged_256k",   iters / 1024, staged_write(driver, 0x1000, sizeof(large_buf), 0xA5));
+    BENCH("read_256k",     iters / 1024, driver.read(0x1000, large_buf, sizeof(large_buf)));
+    BENCH("viewed_256k",   iters / 1024, viewed_read(driver, 0x1000, sizeof(large_buf)));
+    BENCH("writev_256x64", iters / 1024, driver.writev(spans, 256));
+    BENCH("readv_256x64",  iters / 1024, driver.readv(spans, 256));
+    bench_async(port, iters, 1);
+    bench_async(port, iters, 4);
+    bench_coro(port, iters, 1);
+    bench_coro(port, iters, 32);
+
+    delete port;
+    return 0;
+}
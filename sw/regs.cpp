@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_regs.h"
+#include "ftdi_axi_protocol.h"
+#include "ftdi_ft60x.h"
+#include "ftdi_emu.h"
+
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "d:f:qEh"
+
+static struct option long_options[] =
+{
+    {"device",     required_argument, 0, 'd'},
+    {"filename",   required_argument, 0, 'f'},
+    {"quiet",      no_argument,       0, 'q'},
+    {"emulate",    no_argument,       0, 'E'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --device     | -d IDX        Device index to use (default: 0)\n");
+    fprintf (stderr,"  --filename   | -f FILENAME   Register script ('-' for stdin)\n");
+    fprintf (stderr,"  --quiet      | -q            Only report errors and the summary\n");
+    fprintf (stderr,"  --emulate    | -E            Use the in-process target emulator\n");
+    fprintf (stderr,"\n");
+    fprintf (stderr,"Script lines (values in C notation, '#' starts a comment):\n");
+    fprintf (stderr,"  r   ADDR          32-bit read\n");
+    fprintf (stderr,"  w   ADDR VALUE    32-bit write\n");
+    fprintf (stderr,"  wp  ADDR VALUE    32-bit posted write\n");
+    fprintf (stderr,"  w16 ADDR VALUE    16-bit write\n");
+    fprintf (stderr,"  w8  ADDR VALUE    8-bit write\n");
+    fprintf (stderr,"  gw  VALUE         GPIO write\n");
+    fprintf (stderr,"  gr                GPIO read\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// time_now: Wall clock (seconds)
+//-----------------------------------------------------------------
+static double time_now(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + (t.tv_usec / 1000000.0);
+}
+//-----------------------------------------------------------------
+// parse_script: Append the script operations to the sequence
+//-----------------------------------------------------------------
+static bool parse_script(FILE *f, ftdi_axi_regs &regs)
+{
+    char line[256];
+    int  line_num = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        line_num++;
+
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char op[8];
+        char arg1[64];
+        char arg2[64];
+        int  args = sscanf(line, "%7s %63s %63s", op, arg1, arg2);
+        if (args <= 0)
+            continue;
+
+        uint32_t a = (args > 1) ? strtoul(arg1, NULL, 0) : 0;
+        uint32_t v = (args > 2) ? strtoul(arg2, NULL, 0) : 0;
+
+        if (!strcmp(op, "r") && args == 2)
+            regs.read32(a);
+        else if (!strcmp(op, "w") && args == 3)
+            regs.write32(a, v);
+        else if (!strcmp(op, "wp") && args == 3)
+            regs.write32(a, v, true);
+        else if (!strcmp(op, "w16") && args == 3)
+            regs.write16(a, v);
+        else if (!strcmp(op, "w8") && args == 3)
+            regs.write8(a, v);
+        else if (!strcmp(op, "gw") && args == 2)
+            regs.gpio_write(a);
+        else if (!strcmp(op, "gr") && args == 1)
+            regs.gpio_read();
+        else
+        {
+            fprintf (stderr,"Error: Line %d: bad command '%s'\n", line_num, op);
+            return false;
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help       = 0;
+    int device     = 0;
+    char *filename = NULL;
+    bool quiet     = false;
+    bool emulate   = false;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 'd':
+                 device = strtoul(optarg, NULL, 0);
+                 break;
+            case 'f':
+                 filename = optarg;
+                 break;
+            case 'q':
+                 quiet = true;
+                 break;
+            case 'E':
+                 emulate = true;
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (help || filename == NULL)
+    {
+        help_options();
+        return -1;
+    }
+
+    FILE *f = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+    if (!f)
+    {
+        fprintf (stderr,"Error: Could not open %s\n", filename);
+        return -1;
+    }
+
+    // Open the port
+    ftdi_ft60x port_hw;
+    ftdi_emu   port_emu;
+    ftdi_driver_api *port = emulate ? (ftdi_driver_api *)&port_emu : (ftdi_driver_api *)&port_hw;
+    if (!port->open(device))
+        return -1;
+
+    // Reset target state machines
+    ftdi_axi_driver driver(port);
+    driver.send_drain(1000);
+    port->sleep(10000);
+
+    ftdi_axi_regs regs(&driver);
+    bool ok = parse_script(f, regs);
+    if (f != stdin)
+        fclose(f);
+    if (!ok)
+    {
+        port->close();
+        return -1;
+    }
+
+    double t0 = time_now();
+    ok = regs.execute(1000);
+    double t1 = time_now();
+
+    for (int i=0;i<regs.count();i++)
+    {
+        tAxiRegOp &op = regs.op(i);
+        bool read = (op.cmd_id == CMD_ID_READ || op.cmd_id == CMD_ID_GPIO_RD);
+
+        if (!op.ok)
+            printf("%4d: 0x%08x: not completed\n", i, op.addr);
+        else if (op.status)
+            printf("%4d: 0x%08x: AXI error (resp %d)\n", i, op.addr, op.status);
+        else if (read && !quiet)
+        {
+            if (op.cmd_id == CMD_ID_GPIO_RD)
+                printf("%4d: gpio      : 0x%08x (%d)\n", i, op.value, op.value);
+            else
+                printf("%4d: 0x%08x: 0x%08x (%d)\n", i, op.addr, op.value, op.value);
+        }
+    }
+
+    printf("%d operations, %d round trips, %d errors in %.3f ms\n",
+           regs.count(), regs.round_trips(), regs.errors(), (t1 - t0) * 1000.0);
+
+    port->close();
+    return (ok && regs.errors() == 0) ? 0 : -1;
+}
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ftdi_axi_protocol.h"
+#include "ftdi_ft60x.h"
+#include "ftdi_emu.h"
+#include "ftdi_trace.h"
+
+#define REPLAY_TYPES        5
+
+static const char *type_names[REPLAY_TYPES] = { "?", "write", "read", "stream", "sleep" };
+
+//-----------------------------------------------------------------
+// tReplayStats: Recorded vs replayed time per record type
+//-----------------------------------------------------------------
+typedef struct ReplayStats
+{
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t rec_ns;
+    uint64_t replay_ns;
+} tReplayStats;
+
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "f:d:q:Eb:L:Flh"
+
+static struct option long_options[] =
+{
+    {"file",       required_argument, 0, 'f'},
+    {"device",     required_argument, 0, 'd'},
+    {"queue",      required_argument, 0, 'q'},
+    {"emulate",    no_argument,       0, 'E'},
+    {"bandwidth",  required_argument, 0, 'b'},
+    {"latency",    required_argument, 0, 'L'},
+    {"fast",       no_argument,       0, 'F'},
+    {"list",       no_argument,       0, 'l'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --file       | -f FILENAME   Trace file (see load/verify -T)\n");
+    fprintf (stderr,"  --device     | -d IDX        Device index to use (default: 0)\n");
+    fprintf (stderr,"  --queue      | -q DEPTH      Overlapped USB transfers per direction (default: 0)\n");
+    fprintf (stderr,"  --emulate    | -E            Replay against the in-process target emulator\n");
+    fprintf (stderr,"  --bandwidth  | -b MB/s       Emulator link bandwidth (default: unlimited)\n");
+    fprintf (stderr,"  --latency    | -L US         Emulator per-transfer latency (default: 0)\n");
+    fprintf (stderr,"  --fast       | -F            Do not reproduce host idle time between calls\n");
+    fprintf (stderr,"  --list       | -l            List the records instead of replaying\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// time_ns: Monotonic time
+//-----------------------------------------------------------------
+static uint64_t time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+//-----------------------------------------------------------------
+// wait_until: Sleep the bulk, spin the remainder
+//-----------------------------------------------------------------
+static void wait_until(uint64_t t_ns)
+{
+    uint64_t now = time_ns();
+    if (t_ns > now + 200000)
+        usleep((t_ns - now - 100000) / 1000);
+
+    while (time_ns() < t_ns)
+        ;
+}
+//-----------------------------------------------------------------
+// count_commands: Walk whole commands at the start of a write
+//-----------------------------------------------------------------
+static int count_commands(const uint8_t *data, int length, uint8_t &first)
+{
+    int count  = 0;
+    int offset = 0;
+
+    first = 0;
+    while ((offset + (int)sizeof(tCommandBlock)) <= length)
+    {
+        const tCommandBlock *cmd = (const tCommandBlock *)&data[offset];
+        int words = cmd->length ? cmd->length : 256;
+
+        if (count == 0)
+            first = cmd->command;
+
+        offset += sizeof(tCommandBlock);
+        switch (cmd->command)
+        {
+        case CMD_ID_ECHO:
+            offset += cmd->length * 4;
+            break;
+        case CMD_ID_WRITE8_NP:
+        case CMD_ID_WRITE16_NP:
+        case CMD_ID_WRITE_NP:
+        case CMD_ID_WRITE8:
+        case CMD_ID_WRITE16:
+        case CMD_ID_WRITE:
+            offset += words * 4;
+            break;
+        case CMD_ID_GPIO_WR:
+            offset += 4;
+            break;
+        case CMD_ID_DRAIN:
+        case CMD_ID_READ:
+        case CMD_ID_GPIO_RD:
+            break;
+        default:
+            return count;
+        }
+        count++;
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------
+// list_trace: Print one line per record
+//-----------------------------------------------------------------
+static void list_trace(const tTraceHeader *hdr)
+{
+    uint64_t pos = hdr->tail;
+    const tTraceRecord *rec;
+
+    printf("%12s %-6s %8s %8s %10s %s\n", "time(us)", "type", "length", "result", "dur(us)", "commands");
+    while ((rec = ftdi_trace::next_record(hdr, pos)) != NULL)
+    {
+        printf("%12.1f %-6s %8u %8d %10.1f", rec->time_ns / 1000.0,
+               type_names[rec->type < REPLAY_TYPES ? rec->type : 0],
+               rec->length, rec->result, rec->duration_ns / 1000.0);
+
+        if (rec->type == TRACE_REC_WRITE && rec->data_len)
+        {
+            uint8_t first;
+            int count = count_commands((const uint8_t *)(rec + 1), rec->data_len, first);
+            printf(" %d (first %02x)", count, first);
+        }
+        if (rec->flags & TRACE_FLAG_TRUNCATED)
+            printf(" [truncated]");
+        printf("\n");
+    }
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help       = 0;
+    int device     = 0;
+    char *filename = NULL;
+    int queue      = 0;
+    bool emulate   = false;
+    int bandwidth  = 0;
+    int latency    = 0;
+    bool fast      = false;
+    bool list      = false;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 'f':
+                 filename = optarg;
+                 break;
+            case 'd':
+                 device = strtoul(optarg, NULL, 0);
+                 break;
+            case 'q':
+                 queue = strtoul(optarg, NULL, 0);
+                 break;
+            case 'E':
+                 emulate = true;
+                 break;
+            case 'b':
+                 bandwidth = strtoul(optarg, NULL, 0);
+                 break;
+            case 'L':
+                 latency = strtoul(optarg, NULL, 0);
+                 break;
+            case 'F':
+                 fast = true;
+                 break;
+            case 'l':
+                 list = true;
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (help || filename == NULL)
+    {
+        help_options();
+        return -1;
+    }
+
+    // Map the trace
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(tTraceHeader))
+    {
+        fprintf (stderr,"Error: Could not open %s\n", filename);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        fprintf (stderr,"Error: Could not map %s\n", filename);
+        return -1;
+    }
+
+    const tTraceHeader *hdr = (const tTraceHeader *)map;
+    if (hdr->magic != TRACE_MAGIC || hdr->version != TRACE_VERSION ||
+        (uint64_t)st.st_size < hdr->header_size + hdr->capacity)
+    {
+        fprintf (stderr,"Error: %s is not a trace file\n", filename);
+        return -1;
+    }
+
+    time_t start_time = (time_t)hdr->start_time;
+    printf("Trace: %llu records (%llu overwritten), started %s",
+           (unsigned long long)hdr->records, (unsigned long long)hdr->dropped, ctime(&start_time));
+
+    if (list)
+    {
+        list_trace(hdr);
+        munmap(map, st.st_size);
+        close(fd);
+        return 0;
+    }
+
+    // Open the port
+    ftdi_ft60x port_hw;
+    ftdi_emu   port_emu;
+    ftdi_driver_api *port = &port_hw;
+    if (emulate)
+    {
+        port_emu.set_bandwidth(bandwidth);
+        port_emu.set_latency(latency);
+        port = &port_emu;
+    }
+    else
+        port_hw.set_overlapped(queue);
+
+    if (!port->open(device))
+        return -1;
+
+    tReplayStats stats[REPLAY_TYPES];
+    memset(stats, 0, sizeof(stats));
+
+    uint8_t *buf         = NULL;
+    int      buf_size    = 0;
+    uint64_t result_diff = 0;
+    uint64_t data_diff   = 0;
+    uint64_t skipped     = 0;
+    uint64_t rec_first   = 0;
+    uint64_t rec_last    = 0;
+    uint64_t prev_end    = 0;
+    bool     first       = true;
+
+    uint64_t pos = hdr->tail;
+    const tTraceRecord *rec;
+    uint64_t replay_start = time_ns();
+    uint64_t replay_end   = replay_start;
+
+    while ((rec = ftdi_trace::next_record(hdr, pos)) != NULL)
+    {
+        int type = (rec->type < REPLAY_TYPES) ? rec->type : 0;
+        if (type == 0)
+            continue;
+
+        // Host idle time between calls as recorded
+        if (first)
+            rec_first = rec->time_ns;
+        else if (!fast && rec->time_ns > prev_end)
+            wait_until(replay_end + (rec->time_ns - prev_end));
+        first    = false;
+        prev_end = rec->time_ns + rec->duration_ns;
+        if (prev_end > rec_last)
+            rec_last = prev_end;
+
+        const uint8_t *payload = (const uint8_t *)(rec + 1);
+        uint64_t t0 = time_ns();
+
+        switch (type)
+        {
+        case TRACE_REC_WRITE:
+        {
+            if (rec->flags & TRACE_FLAG_TRUNCATED)
+            {
+                skipped++;
+                continue;
+            }
+            int res = port->write((uint8_t *)payload, rec->length, rec->timeout_ms);
+            if (res != rec->result)
+                result_diff++;
+        }
+        break;
+        case TRACE_REC_READ:
+        {
+            if ((int)rec->length > buf_size)
+            {
+                buf_size = rec->length;
+                buf = (uint8_t *)realloc(buf, buf_size);
+            }
+            int res = port->read(buf, rec->length, rec->timeout_ms);
+            if (res != rec->result)
+                result_diff++;
+            else if (res > 0 && rec->data_len == (uint32_t)res && memcmp(buf, payload, res))
+                data_diff++;
+        }
+        break;
+        case TRACE_REC_STREAM:
+            if (port->set_read_stream(rec->length) != (rec->result != 0))
+                result_diff++;
+            break;
+        case TRACE_REC_SLEEP:
+            port->sleep(rec->length);
+            break;
+        }
+
+        replay_end = time_ns();
+        stats[type].count++;
+        stats[type].bytes     += (rec->result > 0 && type <= TRACE_REC_READ) ? rec->result : 0;
+        stats[type].rec_ns    += rec->duration_ns;
+        stats[type].replay_ns += replay_end - t0;
+    }
+
+    port->close();
+    free(buf);
+    munmap(map, st.st_size);
+    close(fd);
+
+    printf("%-7s %10s %12s %14s %14s %8s\n", "type", "count", "bytes", "recorded(ms)", "replayed(ms)", "ratio");
+    for (int i=1;i<REPLAY_TYPES;i++)
+    {
+        tReplayStats &s = stats[i];
+        if (s.count == 0)
+            continue;
+
+        printf("%-7s %10llu %12llu %14.3f %14.3f %8.2f\n", type_names[i],
+               (unsigned long long)s.count, (unsigned long long)s.bytes,
+               s.rec_ns / 1000000.0, s.replay_ns / 1000000.0,
+               s.rec_ns ? ((double)s.replay_ns / s.rec_ns) : 0.0);
+    }
+
+    double rec_ms    = (rec_last - rec_first) / 1000000.0;
+    double replay_ms = (replay_end - replay_start) / 1000000.0;
+    printf("session %14.3f ms recorded, %.3f ms replayed (%.2fx)%s\n",
+           rec_ms, replay_ms, rec_ms > 0 ? replay_ms / rec_ms : 0.0, fast ? ", idle time skipped" : "");
+
+    if (result_diff || data_diff || skipped)
+        printf("differences: %llu results, %llu read payloads, %llu truncated writes skipped\n",
+               (unsigned long long)result_diff, (unsigned long long)data_diff, (unsigned long long)skipped);
+
+    return 0;
+}
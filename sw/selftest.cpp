@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+
+#include "ftdi_axi_driver.h"
+#include "ftdi_axi_async.h"
+#include "ftdi_axi_coro.h"
+#include "ftdi_axi_protocol.h"
+#include "ftdi_emu.h"
+#include "ftdi_ft60x.h"
+
+//-----------------------------------------------------------------
+// Regression checks against the emulated target (no hardware)
+//-----------------------------------------------------------------
+#define CHECK(_cond) do { \
+        if (!(_cond)) { fprintf(stderr, "ERROR: %s:%d: %s\n", __FILE__, __LINE__, #_cond); return false; } \
+    } while (0)
+
+//-----------------------------------------------------------------
+// fault_port: Emulated target with a link that fails on demand
+//-----------------------------------------------------------------
+class fault_port: public ftdi_emu
+{
+public:
+    fault_port() { m_writes_left = -1; m_read_faults = 0; m_short_reads = 0; }
+
+    // Fail every write() after the next 'count' (-1: never fail)
+    void fail_writes_after(int count) { m_writes_left = count; }
+
+    // Time out the next 'count' read() calls (data stays queued)
+    void fail_reads(int count) { m_read_faults = count; }
+
+    // Return half of what the next 'count' read() calls ask for
+    void short_reads(int count) { m_short_reads = count; }
+
+    int read(uint8_t *data, int length, int timeout_ms)
+    {
+        if (m_read_faults > 0)
+        {
+            m_read_faults--;
+            return 0;
+        }
+        if (m_short_reads > 0)
+        {
+            // Transfer ended early - whatever the stream size
+            int stream = m_stream_size;
+            m_short_reads--;
+            m_stream_size = 0;
+            int got = ftdi_emu::read(data, (length / 2) & ~3, timeout_ms);
+            m_stream_size = stream;
+            return got;
+        }
+        return ftdi_emu::read(data, length, timeout_ms);
+    }
+
+    int write(uint8_t *data, int length, int timeout_ms)
+    {
+        if (m_writes_left == 0)
+            return -1;
+        if (m_writes_left > 0)
+            m_writes_left--;
+        return ftdi_emu::write(data, length, timeout_ms);
+    }
+
+protected:
+    int m_writes_left;
+    int m_read_faults;
+    int m_short_reads;
+};
+
+//-----------------------------------------------------------------
+// test_reserve_interleave: Other operations between write_reserve()
+// and write_commit() must not disturb the staged writes
+//-----------------------------------------------------------------
+static bool test_reserve_interleave(void)
+{
+    ftdi_emu port;
+    CHECK(port.open(0));
+
+    uint8_t pattern[64];
+    for (int i=0;i<(int)sizeof(pattern);i++)
+        pattern[i] = 0xA0 + i;
+    port.mem_write(0x2000, pattern, 16);
+
+    ftdi_axi_driver driver(&port);
+
+    tAxiSpan spans[8];
+    int      num_spans = 0;
+    CHECK(driver.write_reserve(0x1000, 64, spans, 8, num_spans) == 64);
+    int offset = 0;
+    for (int i=0;i<num_spans;i++)
+    {
+        memcpy(spans[i].data, pattern + offset, spans[i].length);
+        offset += spans[i].length;
+    }
+
+    // Direct framing paths between reserve and commit
+    uint8_t  rd[16];
+    uint32_t value;
+    CHECK(driver.read(0x2000, rd, sizeof(rd)));
+    CHECK(memcmp(rd, pattern, sizeof(rd)) == 0);
+    CHECK(driver.write32(0x3000, 0x12345678));
+    CHECK(driver.read32(0x3000, value) && value == 0x12345678);
+    CHECK(driver.gpio_write(0x5));
+    CHECK(driver.write_commit(true));
+
+    uint8_t mem[64];
+    port.mem_read(0x1000, mem, sizeof(mem));
+    CHECK(memcmp(mem, pattern, sizeof(mem)) == 0);
+    CHECK(driver.read32(0x1000, value) && value == 0xA3A2A1A0);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// coro_poll: Poll loop which records how it ended
+//-----------------------------------------------------------------
+typedef struct CoroState
+{
+    int      reads;
+    uint32_t value;         // Last value read
+    bool     saw_error;
+    bool     finished;
+} tCoroState;
+
+static ftdi_axi_task coro_poll(ftdi_axi_loop &loop, uint32_t addr, int iters, tCoroState *state)
+{
+    for (int i=0;i<iters;i++)
+    {
+        tAxiResult r = co_await loop.read32(addr);
+        if (!r.ok)
+        {
+            state->saw_error = true;
+            break;
+        }
+        state->value = r.value;
+        state->reads++;
+    }
+    state->finished = true;
+}
+//-----------------------------------------------------------------
+// test_coro_failure: A failed transfer must resume every waiting
+// coroutine with ok = false, let it run to completion, and leave
+// the link usable by the next run
+//-----------------------------------------------------------------
+static bool test_coro_failure(void)
+{
+    fault_port port;
+    CHECK(port.open(0));
+
+    tCoroState state[4];
+    memset(state, 0, sizeof(state));
+
+    ftdi_axi_loop loop(&port);
+    for (int i=0;i<4;i++)
+        loop.spawn(coro_poll(loop, 0x1000 + (i * 4), 10, &state[i]));
+
+    // Three batches get through, the fourth transfer fails
+    port.fail_writes_after(3);
+    CHECK(!loop.run());
+
+    for (int i=0;i<4;i++)
+    {
+        CHECK(state[i].finished);
+        CHECK(state[i].saw_error);
+        CHECK(state[i].reads == 3);
+    }
+
+    // Nothing left suspended: a second run has no work
+    port.fail_writes_after(-1);
+    CHECK(loop.run());
+
+    // Responses lost in transit stay queued in the IN pipe...
+    uint32_t words[4] = { 0x11, 0x22, 0x33, 0x44 };
+    port.mem_write(0x1000, (uint8_t *)words, sizeof(words));
+
+    memset(state, 0, sizeof(state));
+    for (int i=0;i<4;i++)
+        loop.spawn(coro_poll(loop, 0x1000 + (i * 4), 2, &state[i]));
+    port.fail_reads(1);
+    CHECK(!loop.run());
+
+    // ...and must not be parsed as replies by the next run
+    memset(state, 0, sizeof(state));
+    for (int i=0;i<4;i++)
+        loop.spawn(coro_poll(loop, 0x1000 + (i * 4), 2, &state[i]));
+    CHECK(loop.run());
+
+    for (int i=0;i<4;i++)
+    {
+        CHECK(state[i].finished && !state[i].saw_error);
+        CHECK(state[i].reads == 2 && state[i].value == words[i]);
+    }
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_async_resync: A failed batch must not leave stale responses
+// in front of the next one
+//-----------------------------------------------------------------
+static bool test_async_resync(void)
+{
+    fault_port port;
+    CHECK(port.open(0));
+
+    uint32_t words[2] = { 0x11111111, 0x22222222 };
+    port.mem_write(0x1000, (uint8_t *)words, sizeof(words));
+
+    ftdi_axi_async engine(&port);
+    CHECK(engine.start());
+
+    // Response lost in transit, left queued in the IN pipe
+    uint32_t value = 0;
+    port.fail_reads(1);
+    CHECK(!engine.read32(0x1000, &value).get());
+
+    for (int i=0;i<4;i++)
+    {
+        value = 0;
+        CHECK(engine.read32(0x1004, &value).get());
+        CHECK(value == 0x22222222);
+    }
+
+    // Unaligned blocks are rejected, not issued
+    uint8_t buf[8];
+    CHECK(!engine.read(0x1001, buf, 4).get());
+    CHECK(!engine.write(0x1000, buf, 6).get());
+    CHECK(engine.read32(0x1000, &value).get() && value == 0x11111111);
+
+    engine.stop();
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_wc_cache: A write-combined write lost on the link must not
+// stay in the line cache
+//-----------------------------------------------------------------
+static bool test_wc_cache(void)
+{
+    fault_port port;
+    CHECK(port.open(0));
+
+    uint32_t words[4] = { 0x10, 0x20, 0x30, 0x40 };
+    port.mem_write(0x4000, (uint8_t *)words, sizeof(words));
+
+    ftdi_axi_driver driver(&port);
+    CHECK(driver.add_region(0x4000, 0x1000, AXI_REGION_WRITE_THROUGH));
+    driver.set_write_combining(8);
+
+    uint32_t value;
+    CHECK(driver.read32(0x4000, value) && value == 0x10);
+
+    // Second write fills the combining limit, its send fails
+    CHECK(driver.write32(0x4000, 0xAAAA, 100, true));
+    port.fail_writes_after(0);
+    CHECK(!driver.write32(0x4004, 0xBBBB, 100, true));
+    port.fail_writes_after(-1);
+
+    CHECK(driver.read32(0x4000, value) && value == 0x10);
+    CHECK(driver.read32(0x4004, value) && value == 0x20);
+
+    // Held writes lost by a flush ahead of another operation
+    CHECK(driver.write32(0x4008, 0xCCCC, 100, true));
+    port.fail_writes_after(0);
+    CHECK(!driver.gpio_write(1));
+    port.fail_writes_after(-1);
+
+    CHECK(driver.read32(0x4008, value) && value == 0x30);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_wc_teardown: Writes still held for combining are sent when
+// the driver goes away
+//-----------------------------------------------------------------
+static bool test_wc_teardown(void)
+{
+    ftdi_emu port;
+    CHECK(port.open(0));
+
+    {
+        ftdi_axi_driver driver(&port);
+        driver.set_write_combining(64);
+        CHECK(driver.write32(0x5000, 0x1234, 100, true));
+        CHECK(driver.write32(0x5004, 0x5678, 100, true));
+    }
+
+    uint32_t words[2];
+    port.mem_read(0x5000, (uint8_t *)words, sizeof(words));
+    CHECK(words[0] == 0x1234 && words[1] == 0x5678);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_wc_idle: Writes held for combining reach the target once
+// they time out while the driver is idle
+//-----------------------------------------------------------------
+static bool test_wc_idle(void)
+{
+    ftdi_emu port;
+    CHECK(port.open(0));
+
+    ftdi_axi_driver driver(&port);
+    driver.set_write_combining(64);
+    driver.set_write_combining_timeout(1000);
+
+    uint32_t value = 0;
+    CHECK(driver.write32(0x6000, 0xCAFE, 100, true));
+    CHECK(driver.poll());
+    port.mem_read(0x6000, (uint8_t *)&value, 4);
+    CHECK(value == 0);
+
+    port.sleep(2000);
+    CHECK(driver.poll());
+    port.mem_read(0x6000, (uint8_t *)&value, 4);
+    CHECK(value == 0xCAFE);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_stream_retry: A short read in stream mode is completed with
+// the stream cleared (remainders are not whole stream transfers)
+//-----------------------------------------------------------------
+static bool test_stream_retry(void)
+{
+    static uint8_t pattern[256 * 1024];
+    static uint8_t rd[sizeof(pattern)];
+
+    fault_port port;
+    CHECK(port.open(0));
+
+    for (int i=0;i<(int)sizeof(pattern);i++)
+        pattern[i] = (uint8_t)((i * 7) + (i >> 10));
+    port.mem_write(0x100000, pattern, sizeof(pattern));
+
+    ftdi_axi_driver driver(&port);
+    driver.set_stream_reads(true);
+
+    port.short_reads(1);
+    CHECK(driver.read(0x100000, rd, sizeof(rd)));
+    CHECK(memcmp(rd, pattern, sizeof(rd)) == 0);
+
+    tAxiDriverStats stats;
+    driver.get_stats(stats);
+    CHECK(stats.read_retries == 1);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// test_cache_span: A write starting outside a write-through region
+// and ending inside it updates the cached lines it reaches
+//-----------------------------------------------------------------
+static bool test_cache_span(void)
+{
+    ftdi_emu port;
+    CHECK(port.open(0));
+
+    ftdi_axi_driver driver(&port);
+    CHECK(driver.add_region(0x8000, 0x100, AXI_REGION_WRITE_THROUGH));
+
+    uint32_t value;
+    CHECK(driver.read32(0x8000, value) && value == 0);
+    CHECK(driver.read32(0x8040, value) && value == 0);
+
+    uint8_t data[0x80];
+    for (int i=0;i<(int)sizeof(data);i++)
+        data[i] = i + 1;
+    CHECK(driver.write(0x7FC0, data, sizeof(data)));
+
+    // Target changed behind the cache: hits must hold the new data
+    uint32_t junk[32];
+    memset(junk, 0xEE, sizeof(junk));
+    port.mem_write(0x8000, (uint8_t *)junk, sizeof(junk));
+
+    CHECK(driver.read32(0x8000, value) && value == 0x44434241);
+    CHECK(driver.read32(0x803C, value) && value == 0x807F7E7D);
+    CHECK(driver.read32(0x8040, value) && value == 0);
+
+    port.close();
+    return true;
+}
+
+//-----------------------------------------------------------------
+// fault_ft60x: FT60x port posing as open whose OUT queue cannot be
+// set up (no device or D3XX calls are made)
+//-----------------------------------------------------------------
+class fault_ft60x: public ftdi_ft60x
+{
+public:
+    fault_ft60x()  { m_handle = this; }
+    ~fault_ft60x() { m_handle = NULL; }
+
+    int  depth(void)     { return m_ovl_depth; }
+    bool released(void)  { return m_rd_q.bufs == NULL && m_wr_q.bufs == NULL; }
+
+protected:
+    bool queue_init(tFt60xQueue &q)
+    {
+        if (&q == &m_wr_q)
+            return false;
+
+        // IN queue buffers only - no OVERLAPPED state to release
+        q.head    = 0;
+        q.count   = 0;
+        q.timeout = -1;
+        q.bufs    = (uint8_t *)malloc(m_ovl_depth * m_ovl_size);
+        return q.bufs != NULL;
+    }
+};
+
+//-----------------------------------------------------------------
+// test_ovl_fallback: A failed overlapped set up must free both
+// queues and leave the port on blocking transfers
+//-----------------------------------------------------------------
+static bool test_ovl_fallback(void)
+{
+    fault_ft60x port;
+
+    CHECK(!port.set_overlapped(4));
+    CHECK(port.depth() == 0);
+    CHECK(port.released());
+    return true;
+}
+
+//-----------------------------------------------------------------
+// Test table
+//-----------------------------------------------------------------
+typedef struct SelfTest
+{
+    const char *name;
+    bool      (*func)(void);
+} tSelfTest;
+
+static const tSelfTest tests[] =
+{
+    { "reserve_interleave", test_reserve_interleave },
+    { "coro_failure",       test_coro_failure },
+    { "async_resync",       test_async_resync },
+    { "wc_cache",           test_wc_cache },
+    { "wc_teardown",        test_wc_teardown },
+    { "wc_idle",            test_wc_idle },
+    { "ovl_fallback",       test_ovl_fallback },
+    { "stream_retry",       test_stream_retry },
+    { "cache_span",         test_cache_span },
+};
+
+#define NUM_TESTS   ((int)(sizeof(tests) / sizeof(tests[0])))
+
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "t:lh"
+
+static struct option long_options[] =
+{
+    {"test",       required_argument, 0, 't'},
+    {"list",       no_argument,       0, 'l'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --test       | -t IDX        Run one test (default: all)\n");
+    fprintf (stderr,"  --list       | -l            List the tests\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help     = 0;
+    int test_idx = -1;
+    bool list    = false;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 't':
+                 test_idx = strtoul(optarg, NULL, 0);
+                 break;
+            case 'l':
+                 list = true;
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (help || test_idx >= NUM_TESTS)
+    {
+        help_options();
+        return -1;
+    }
+
+    int failed = 0;
+    for (int i=0;i<NUM_TESTS;i++)
+    {
+        if (test_idx >= 0 && i != test_idx)
+            continue;
+
+        if (list)
+        {
+            printf("%2d: %s\n", i, tests[i].name);
+            continue;
+        }
+
+        bool ok = tests[i].func();
+        printf("%-24s %s\n", tests[i].name, ok ? "PASS" : "FAIL");
+        if (!ok)
+            failed++;
+    }
+
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <getopt.h>
+
+#include "ftdi_axi_driver.h"
+#include "ftdi_ft60x.h"
+
+//-----------------------------------------------------------------
+// Command line options
+//-----------------------------------------------------------------
+#define GETOPTS_ARGS "d:a:s:o:h"
+
+static struct option long_options[] =
+{
+    {"device",     required_argument, 0, 'd'},
+    {"address",    required_argument, 0, 'a'},
+    {"size",       required_argument, 0, 's'},
+    {"output",     required_argument, 0, 'o'},
+    {"help",       no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help_options(void)
+{
+    fprintf (stderr,"Usage:\n");
+    fprintf (stderr,"  --device     | -d IDX        Device index to use (default: 0)\n");
+    fprintf (stderr,"  --address    | -a ADDR       Scratch memory address (contents are overwritten)\n");
+    fprintf (stderr,"  --size       | -s SIZE       Transfer size per measurement (default: 4MB)\n");
+    fprintf (stderr,"  --output     | -o FILENAME   Save best settings to file\n");
+    exit(-1);
+}
+//-----------------------------------------------------------------
+// main:
+//-----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int c;
+    int help       = 0;
+    int device     = 0;
+    uint32_t addr  = 0xFFFFFFFF;
+    int size       = (4 * 1024 * 1024);
+    char *filename = NULL;
+
+    int option_index = 0;
+    while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
+    {
+        switch(c)
+        {
+            case 'd':
+                 device = strtoul(optarg, NULL, 0);
+                 break;
+            case 'a':
+                 addr = strtoul(optarg, NULL, 0) & ~3;
+                 break;
+            case 's':
+                 size = strtol(optarg, NULL, 0);
+                 break;
+            case 'o':
+                 filename = optarg;
+                 break;
+            default:
+                help = 1;
+                break;
+        }
+    }
+
+    if (help || addr == 0xFFFFFFFF || size <= 0)
+    {
+        help_options();
+        return -1;
+    }
+
+    // Open the port
+    ftdi_ft60x port;
+    if (!port.open(0))
+        return -1;
+
+    // Reset target state machines
+    ftdi_axi_driver driver(&port);
+    driver.send_drain(1000);
+    port.sleep(10000);
+
+    bool ok = driver.autotune(addr, size);
+    if (!ok)
+        fprintf(stderr, "ERROR: Tuning failed\n");
+    else if (filename)
+    {
+        ok = driver.save_settings(filename);
+        if (ok)
+            printf("Settings saved to %s\n", filename);
+        else
+            fprintf(stderr, "ERROR: Could not write %s\n", filename);
+    }
+
+    port.close();
+    return ok ? 0 : -1;
+}
@@ -4,14 +4,24 @@
 #include <unistd.h>
 #include <assert.h>
 #include <getopt.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "ftdi_axi_driver.h"
 #include "ftdi_ft60x.h"
+#include "ftdi_trace.h"
+#include "ftdi_read_ahead.h"
+#ifdef FTDI_VSIM
+#include "ftdi_vsim.h"
+#endif
 
 //-----------------------------------------------------------------
 // Command line options
 //-----------------------------------------------------------------
-#define GETOPTS_ARGS "d:a:s:f:h"
+#define GETOPTS_ARGS "d:a:s:f:c:q:T:b:m:h"
+
+#define DEFAULT_MAX_REPORT  64
 
 static struct option long_options[] =
 {
@@ -19,6 +29,11 @@ static struct option long_options[] =
     {"address",      required_argument, 0, 'a'},
     {"size",         required_argument, 0, 's'},
     {"filename",     required_argument, 0, 'f'},
+    {"config",       required_argument, 0, 'c'},
+    {"queue",        required_argument, 0, 'q'},
+    {"trace",        required_argument, 0, 'T'},
+    {"chunk",        required_argument, 0, 'b'},
+    {"max-report",   required_argument, 0, 'm'},
     {"help",         no_argument,       0, 'h'},
     {0, 0, 0, 0}
 };
@@ -30,51 +45,116 @@ static void help_options(void)
     fprintf (stderr,"  --address    | -a ADDR       Address to compare file to (default: 0)\n");
     fprintf (stderr,"  --filename   | -f FILENAME   File to compare\n");
     fprintf (stderr,"  --size       | -s SIZE       File size (default: actual file size)\n");
+    fprintf (stderr,"  --config     | -c FILENAME   Driver settings file (see tune)\n");
+    fprintf (stderr,"  --queue      | -q DEPTH      Overlapped USB transfers per direction (default: 0)\n");
+    fprintf (stderr,"  --trace      | -T FILENAME   Record USB traffic to a trace file (see replay)\n");
+    fprintf (stderr,"  --chunk      | -b BYTES      Compare chunk size (default: 4MB, %d read ahead)\n", READ_AHEAD_BUFFERS);
+    fprintf (stderr,"  --max-report | -m COUNT      Mismatching ranges to list (default: %d, 0 = all)\n", DEFAULT_MAX_REPORT);
     exit(-1);
 }
 //-----------------------------------------------------------------
-// load_file_to_mem
+// tCompare: Mismatch ranges found so far (may span chunks)
 //-----------------------------------------------------------------
-static uint8_t* load_file_to_mem(const char *filename, long size_override, int *pSize)
+typedef struct Compare
 {
-    uint8_t *file_buf = NULL;
-    FILE *f = fopen(filename, "rb");
+    uint32_t addr;          // Target address of file offset 0
+    int      max_report;    // Ranges to print (0 = all)
+    uint64_t bytes;         // Differing bytes
+    uint64_t ranges;        // Runs of differing bytes
+    bool     open;          // A run continues into the next chunk
+    uint64_t start;         // File offset of the open run
+    uint8_t  file_val;      // First differing byte of the open run
+    uint8_t  target_val;
+} tCompare;
 
-    *pSize = 0;
+//-----------------------------------------------------------------
+// scan: Offset of the first byte at or after pos which differs
+// (want_diff) or matches (!want_diff), length if there is none.
+// SSE2 builds test 64 bytes per step.
+//-----------------------------------------------------------------
+static int scan(const uint8_t *a, const uint8_t *b, int pos, int length, bool want_diff)
+{
+#ifdef __SSE2__
+    // Equal-byte masks inverted so that set bits are the bytes sought
+    uint64_t flip = want_diff ? ~0ULL : 0;
 
-    if (f)
+    while ((pos + 64) <= length)
     {
-        long size;
-
-        // Get size of file
-        fseek(f, 0, SEEK_END);
-        size = ftell(f);
-        rewind(f);
-
-        // User overriden file size
-        if (size_override >= 0)
+        uint64_t eq = 0;
+        for (int i=0;i<4;i++)
         {
-            if (size > size_override)
-                size = size_override;
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + pos + (i * 16)));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + pos + (i * 16)));
+            eq |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) << (i * 16);
         }
 
-        file_buf = new uint8_t[size];
-        if (file_buf)
+        uint64_t hits = eq ^ flip;
+        if (hits)
+            return pos + __builtin_ctzll(hits);
+        pos += 64;
+    }
+#else
+    // Skip identical words
+    if (want_diff)
+    {
+        while ((pos + 8) <= length)
         {
-            // Read file data into allocated memory
-            int len = fread(file_buf, 1, size, f);
-            if (len != size)
-            {
-                delete[] file_buf;
-                file_buf = NULL;
-            }
-            else
-                *pSize = size;
+            uint64_t wa, wb;
+            memcpy(&wa, a + pos, 8);
+            memcpy(&wb, b + pos, 8);
+            if (wa != wb)
+                break;
+            pos += 8;
         }
-        fclose(f);
     }
+#endif
+
+    while (pos < length && ((a[pos] != b[pos]) != want_diff))
+        pos++;
+
+    return pos;
+}
+//-----------------------------------------------------------------
+// close_range: Count (and maybe print) a finished mismatch run
+//-----------------------------------------------------------------
+static void close_range(tCompare *cmp, uint64_t end)
+{
+    if (cmp->max_report == 0 || cmp->ranges < (uint64_t)cmp->max_report)
+        printf("\r  0x%08llx - 0x%08llx: %llu bytes differ (first: file %02x, target %02x)\n",
+               (unsigned long long)(cmp->addr + cmp->start), (unsigned long long)(cmp->addr + end - 1),
+               (unsigned long long)(end - cmp->start), cmp->file_val, cmp->target_val);
+
+    cmp->ranges++;
+    cmp->open = false;
+}
+//-----------------------------------------------------------------
+// compare_chunk: Find the mismatch runs in one chunk
+//-----------------------------------------------------------------
+static void compare_chunk(tCompare *cmp, uint64_t offset, const uint8_t *file, const uint8_t *target, int length)
+{
+    int pos = 0;
 
-    return file_buf;
+    while (pos < length)
+    {
+        if (!cmp->open)
+        {
+            pos = scan(file, target, pos, length, true);
+            if (pos == length)
+                break;
+
+            cmp->open       = true;
+            cmp->start      = offset + pos;
+            cmp->file_val   = file[pos];
+            cmp->target_val = target[pos];
+        }
+
+        int end = scan(file, target, pos, length, false);
+        cmp->bytes += end - pos;
+        pos = end;
+
+        if (pos < length)
+            close_range(cmp, offset + pos);
+    }
 }
 //-----------------------------------------------------------------
 // main:
@@ -85,8 +165,13 @@ int main(int argc, char *argv[])
     int      help      = 0;
     int      device    = 0;
     uint32_t addr      = 0;
-    long     size_override = -1;
+    int64_t  size_override = -1;
+    int      chunk    = READ_AHEAD_DEFAULT_CHUNK;
+    int      max_report = DEFAULT_MAX_REPORT;
     char *   filename = NULL;
+    char *   config   = NULL;
+    char *   trace_file = NULL;
+    int      queue    = 0;
 
     int option_index = 0;
     while ((c = getopt_long (argc, argv, GETOPTS_ARGS, long_options, &option_index)) != -1)
@@ -103,7 +188,22 @@ int main(int argc, char *argv[])
                  filename = optarg;
                  break;
             case 's':
-                 size_override = strtol(optarg, NULL, 0);
+                 size_override = strtoll(optarg, NULL, 0);
+                 break;
+            case 'c':
+                 config = optarg;
+                 break;
+            case 'q':
+                 queue = strtoul(optarg, NULL, 0);
+                 break;
+            case 'T':
+                 trace_file = optarg;
+                 break;
+            case 'b':
+                 chunk = strtoul(optarg, NULL, 0);
+                 break;
+            case 'm':
+                 max_report = strtoul(optarg, NULL, 0);
                  break;
             default:
                 help = 1;
@@ -111,53 +211,167 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (help || filename == NULL)
+    if (help || filename == NULL || chunk <= 0 || max_report < 0)
     {
         help_options();
         return -1;
     }
 
     // Open the port
+#ifdef FTDI_VSIM
+    ftdi_vsim port;
+#else
     ftdi_ft60x port;
+    port.set_overlapped(queue);
+#endif
     if (!port.open(0))
         return -1;
 
+    // Optionally record everything crossing the port
+    ftdi_trace trace(&port);
+    ftdi_driver_api *link = &port;
+    if (trace_file)
+    {
+        if (!trace.start(trace_file))
+        {
+            port.close();
+            return -1;
+        }
+        link = &trace;
+    }
+
     // Reset target state machines
-    ftdi_axi_driver driver(&port);
+    ftdi_axi_driver driver(link);
+    if (config && !driver.load_settings(config))
+    {
+        fprintf (stderr,"Error: Could not load settings from %s\n", config);
+        port.close();
+        return -1;
+    }
     driver.send_drain(1000);
-    port.sleep(10000);
+    link->sleep(10000);
 
-    // Read file into memory
     bool ok = true;
-    int size = 0;
-    uint8_t *file_buf = load_file_to_mem(filename, size_override, &size);
-    if (file_buf)
+
+#ifdef FTDI_VSIM
+    // Nothing persists between simulations: seed the AXI memory
     {
-        printf("Reading %s (%dKB) from 0x%x...\n", filename, (size + 1023) / 1024, addr);
-
-        // Download file from target
-        uint8_t *read_buf = new uint8_t[size];
-        ok = driver.read(addr, read_buf, size);
-        if (!ok)
-            fprintf(stderr, "ERROR: Could not read from target\n");
-
-        // Compare contents
-        if (ok)
-            ok = memcmp(file_buf, read_buf, size) == 0;
-
-        // Free memory
-        delete[] file_buf;
-        delete[] read_buf;
-        file_buf = read_buf = NULL;
-
-        if (ok)
-            printf("Target contents match!\n");
-        else
-            fprintf(stderr, "ERROR: Target contents mismatch!\n");
+        ftdi_read_ahead seed;
+        if (!seed.open(filename, size_override, chunk))
+        {
+            fprintf (stderr,"Error: Could not open file\n");
+            port.close();
+            return -1;
+        }
+
+        for (uint64_t offset = 0; ok && offset < seed.size(); )
+        {
+            uint8_t *data;
+            int      length = seed.next(data);
+            ok = length > 0;
+            if (ok)
+                port.mem_write(addr + (uint32_t)offset, data, length);
+            offset += length;
+            seed.release();
+        }
+        port.reset_stats();
     }
-    else
+#endif
+
+    // Stream the file: disk reads run ahead of the USB reads, and each
+    // chunk is compared as soon as the target copy arrives
+    ftdi_read_ahead file;
+    if (!file.open(filename, size_override, chunk))
     {
         fprintf (stderr,"Error: Could not open file\n");
+        port.close();
+        return -1;
+    }
+
+    uint64_t size = file.size();
+    if ((addr + size) > 0x100000000ULL)
+    {
+        fprintf (stderr,"Error: %llu bytes at 0x%x exceed the 32-bit address space\n", (unsigned long long)size, addr);
+        file.close();
+        port.close();
+        return -1;
+    }
+
+    uint8_t *read_buf = new uint8_t[chunk];
+
+    printf("Reading %s (%lluKB) from 0x%x...\n", filename, (unsigned long long)(size + 1023) / 1024, addr);
+
+    tCompare cmp;
+    memset(&cmp, 0, sizeof(cmp));
+    cmp.addr       = addr;
+    cmp.max_report = max_report;
+
+    // Download and compare
+    double t1 = ftdi_time_now();
+
+    uint64_t done       = 0;
+    double   last_print = t1;
+
+    while (ok && done < size)
+    {
+        // Target first: the disk catches up in the meantime
+        int length = ((size - done) < (uint64_t)chunk) ? (int)(size - done) : chunk;
+        if (!driver.read(addr + (uint32_t)done, read_buf, length))
+        {
+            fprintf(stderr, "\nERROR: Could not read from target at 0x%llx\n", (unsigned long long)(addr + done));
+            ok = false;
+            break;
+        }
+
+        uint8_t *data;
+        if (file.next(data) != length)
+        {
+            fprintf (stderr,"\nError: Could not read file at offset %llu\n", (unsigned long long)done);
+            ok = false;
+            break;
+        }
+
+        compare_chunk(&cmp, done, data, read_buf, length);
+        done += length;
+        file.release();
+
+        double now = ftdi_time_now();
+        if ((now - last_print) >= 0.5 || done == size)
+        {
+            ftdi_print_progress(done, size, now - t1);
+            last_print = now;
+        }
+    }
+
+    double disk_wait = file.get_wait_time();
+    file.close();
+
+    double t2 = ftdi_time_now();
+    if (cmp.open)
+        close_range(&cmp, done);
+    if (done)
+        printf("\n");
+
+    if (ok && size > 0)
+    {
+#ifdef FTDI_VSIM
+        port.print_stats(stdout);
+#else
+        printf("%.2f MB/s, waited %.1f ms on disk\n", (size / (1024.0 * 1024.0)) / (t2 - t1), disk_wait * 1000.0);
+#endif
+    }
+
+    delete[] read_buf;
+
+    if (ok && cmp.ranges == 0)
+        printf("Target contents match!\n");
+    else if (cmp.ranges)
+    {
+        if (max_report && cmp.ranges > (uint64_t)max_report)
+            printf("  ... %llu more ranges\n", (unsigned long long)(cmp.ranges - max_report));
+        fflush(stdout);
+        fprintf(stderr, "ERROR: Target contents mismatch! %llu bytes differ in %llu ranges\n",
+                (unsigned long long)cmp.bytes, (unsigned long long)cmp.ranges);
         ok = false;
     }
 